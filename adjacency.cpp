@@ -0,0 +1,181 @@
+#include "adjacency.hpp"
+#include<vector>
+#include<unordered_set>
+#include<algorithm>
+#include<iterator>
+
+Adjacency::~Adjacency() {
+  Reset();
+}
+
+Adjacency::Adjacency(const Adjacency& other) :
+  size_(other.size_), mode_(other.mode_) {
+  if(mode_ == kInline) {
+    std::copy(other.inline_, other.inline_ + size_, inline_);
+  } else if(mode_ == kSorted) {
+    sorted_ = new std::vector<int64>(*other.sorted_);
+  } else {
+    hashed_ = new std::unordered_set<int64>(*other.hashed_);
+  }
+}
+
+Adjacency::Adjacency(Adjacency&& other) : size_(0), mode_(kInline) {
+  swap(other);
+}
+
+Adjacency& Adjacency::operator=(Adjacency other) {
+  // copy and swap, other takes our old storage with it
+  swap(other);
+  return *this;
+}
+
+void Adjacency::swap(Adjacency& other) {
+  // the union is plain old data either way, so swapping the raw bytes is
+  // enough to hand over pointers as well as inline ids
+  std::swap(size_, other.size_);
+  std::swap(mode_, other.mode_);
+  for(int i = 0; i < kInlineCapacity; ++i) {
+    std::swap(inline_[i], other.inline_[i]);
+  }
+}
+
+void Adjacency::Reset() {
+  if(mode_ == kSorted) {
+    delete sorted_;
+  } else if(mode_ == kHashed) {
+    delete hashed_;
+  }
+  mode_ = kInline;
+  size_ = 0;
+}
+
+bool Adjacency::Contains(int64 id) const {
+  if(mode_ == kInline) {
+    // at most kInlineCapacity entries, a linear scan beats anything clever
+    for(unsigned int i = 0; i < size_; ++i) {
+      if(inline_[i] == id) return true;
+    }
+    return false;
+  } else if(mode_ == kSorted) {
+    return std::binary_search(sorted_->begin(), sorted_->end(), id);
+  }
+  return hashed_->find(id) != hashed_->end();
+}
+
+bool Adjacency::Insert(int64 id, int64 hash_threshold) {
+  if(mode_ == kInline) {
+    int64* end = inline_ + size_;
+    int64* pos = std::lower_bound(inline_, end, id);
+    if(pos != end && *pos == id) return false;
+    if(size_ < kInlineCapacity) {
+      // shift the tail right by one and drop the id in
+      std::copy_backward(pos, end, end + 1);
+      *pos = id;
+      ++size_;
+      return true;
+    }
+    // out of room, move everything to a sorted vector
+    auto spill = new std::vector<int64>(inline_, end);
+    sorted_ = spill;
+    mode_ = kSorted;
+  }
+  if(mode_ == kSorted) {
+    auto pos = std::lower_bound(sorted_->begin(), sorted_->end(), id);
+    if(pos != sorted_->end() && *pos == id) return false;
+    if(static_cast<int64>(sorted_->size()) < hash_threshold) {
+      sorted_->insert(pos, id);
+      ++size_;
+      return true;
+    }
+    // inserting in the middle of a big vector is O(degree), switch to
+    // hashing from here on
+    auto spill = new std::unordered_set<int64>(sorted_->begin(), sorted_->end());
+    delete sorted_;
+    hashed_ = spill;
+    mode_ = kHashed;
+  }
+  if(!hashed_->insert(id).second) return false;
+  ++size_;
+  return true;
+}
+
+int64 Adjacency::InsertSorted(const int64* ids, int64 count,
+                              int64 hash_threshold) {
+  if(count == 0) return 0;
+  int64 before = size_;
+  if(mode_ == kHashed) {
+    hashed_->reserve(size_ + count);
+    for(int64 i = 0; i < count; ++i) {
+      if(hashed_->insert(ids[i]).second) ++size_;
+    }
+    return size_ - before;
+  }
+  // both sides are sorted, so one merge does it
+  const int64* begin = mode_ == kInline ? inline_ : sorted_->data();
+  std::vector<int64> merged;
+  merged.reserve(size_ + count);
+  std::set_union(begin, begin + size_, ids, ids + count,
+                 std::back_inserter(merged));
+  int64 size = merged.size();
+  if(size <= kInlineCapacity && mode_ == kInline) {
+    std::copy(merged.begin(), merged.end(), inline_);
+  } else if(size <= hash_threshold && size > kInlineCapacity / 2) {
+    if(mode_ == kSorted) {
+      sorted_->swap(merged);
+    } else {
+      sorted_ = new std::vector<int64>(std::move(merged));
+      mode_ = kSorted;
+    }
+  } else if(size > hash_threshold) {
+    auto spill = new std::unordered_set<int64>(merged.begin(), merged.end());
+    if(mode_ == kSorted) delete sorted_;
+    hashed_ = spill;
+    mode_ = kHashed;
+  } else {
+    // a sorted vector that Erase would have shrunk back inline anyway
+    delete sorted_;
+    std::copy(merged.begin(), merged.end(), inline_);
+    mode_ = kInline;
+  }
+  size_ = size;
+  return size_ - before;
+}
+
+bool Adjacency::Erase(int64 id) {
+  if(mode_ == kInline) {
+    int64* end = inline_ + size_;
+    int64* pos = std::lower_bound(inline_, end, id);
+    if(pos == end || *pos != id) return false;
+    std::copy(pos + 1, end, pos);
+    --size_;
+    return true;
+  }
+  if(mode_ == kSorted) {
+    auto pos = std::lower_bound(sorted_->begin(), sorted_->end(), id);
+    if(pos == sorted_->end() || *pos != id) return false;
+    sorted_->erase(pos);
+    --size_;
+    // only go back inline once we are well below the capacity, so that a
+    // node bouncing around the limit doesn't reallocate every time
+    if(size_ <= kInlineCapacity / 2) {
+      std::vector<int64>* old = sorted_;
+      std::copy(old->begin(), old->end(), inline_);
+      delete old;
+      mode_ = kInline;
+    }
+    return true;
+  }
+  if(hashed_->erase(id) == 0) return false;
+  --size_;
+  // same idea, a hash set of a few dozen ids is mostly wasted space.
+  // kInlineCapacity * 4 is far below any sensible threshold but still
+  // leaves room for the vector to grow again
+  if(size_ <= kInlineCapacity * 4) {
+    std::unordered_set<int64>* old = hashed_;
+    sorted_ = new std::vector<int64>(old->begin(), old->end());
+    std::sort(sorted_->begin(), sorted_->end());
+    delete old;
+    mode_ = kSorted;
+  }
+  return true;
+}
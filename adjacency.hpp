@@ -0,0 +1,77 @@
+#ifndef ADJACENCY_H_INCLUDE
+#define ADJACENCY_H_INCLUDE
+#include<vector>
+#include<unordered_set>
+#include<algorithm>
+
+typedef long long int64;
+
+// A set of neighbor ids, tuned for the fact that almost every node has
+// only a handful of edges. It changes representation as it grows:
+//  1. up to kInlineCapacity ids live sorted inside the object itself, so a
+//     low degree node costs no heap allocation at all
+//  2. past that, a sorted std::vector (binary search to look up, plain
+//     sequential scan to iterate)
+//  3. past a configurable threshold, a std::unordered_set so that inserts
+//     and erases on huge hubs stay O(1)
+// It shrinks back down (with some slack so we don't flip-flop) when ids
+// are erased.
+class Adjacency {
+ public:
+  static const int kInlineCapacity = 4;
+  // default degree at which a sorted vector turns into a hash set
+  static const int64 kDefaultHashThreshold = 128;
+
+  Adjacency() : size_(0), mode_(kInline) {}
+  ~Adjacency();
+  Adjacency(const Adjacency& other);
+  Adjacency(Adjacency&& other);
+  Adjacency& operator=(Adjacency other);
+  void swap(Adjacency& other);
+
+  // Adds the id, returns false if it was already there. hash_threshold is
+  // the degree above which the set switches to hashing.
+  bool Insert(int64 id, int64 hash_threshold);
+
+  // Adds count ids at once. ids must be sorted and without repeats. This
+  // merges them in with a single allocation instead of shifting the array
+  // once per id. Returns how many of them were new.
+  int64 InsertSorted(const int64* ids, int64 count, int64 hash_threshold);
+
+  // Removes the id, returns false if it was not there.
+  bool Erase(int64 id);
+
+  bool Contains(int64 id) const;
+
+  int64 size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  // Calls f(id) for every id. Ids come out in increasing order unless the
+  // set has switched to hashing. Do not modify the set from inside f.
+  template<typename F>
+  void ForEach(F f) const {
+    if(mode_ == kInline) {
+      for(unsigned int i = 0; i < size_; ++i) f(inline_[i]);
+    } else if(mode_ == kSorted) {
+      for(int64 id : *sorted_) f(id);
+    } else {
+      for(int64 id : *hashed_) f(id);
+    }
+  }
+
+ private:
+  enum Mode : unsigned char { kInline, kSorted, kHashed };
+
+  // release whatever is on the heap and go back to an empty inline set
+  void Reset();
+
+  unsigned int size_;
+  Mode mode_;
+  union {
+    int64 inline_[kInlineCapacity];
+    std::vector<int64>* sorted_;
+    std::unordered_set<int64>* hashed_;
+  };
+};
+
+#endif
@@ -0,0 +1,134 @@
+#include "betweenness.hpp"
+#include<vector>
+#include<cmath>
+#include<cstdint>
+#include<memory>
+#include<limits>
+
+namespace {
+
+// What one thread needs to run Brandes from its sources, reused from
+// source to source. Only the entries of the nodes the last BFS reached
+// are dirty, and those are all in order, so resetting is cheap.
+struct Scratch {
+  explicit Scratch(int64 count) :
+    distance(count, -1), paths(count, 0.0), dependency(count, 0.0),
+    centrality(count, 0.0) {
+    order.reserve(count);
+  }
+
+  std::vector<int32> distance;
+  // number of shortest paths from the source, a double because it can
+  // outgrow any integer on graphs with many equal length paths
+  std::vector<double> paths;
+  std::vector<double> dependency;
+  // nodes in the order the BFS reached them, which doubles as its queue
+  std::vector<int32> order;
+  // this thread's totals
+  std::vector<double> centrality;
+};
+
+// Adds the dependencies of every node on source, times scale, to the
+// scratch's totals.
+void AddDependencies(const CsrGraph& graph, int32 source, double scale,
+                     Scratch* scratch) {
+  std::vector<int32>& distance = scratch->distance;
+  std::vector<double>& paths = scratch->paths;
+  std::vector<double>& dependency = scratch->dependency;
+  std::vector<int32>& order = scratch->order;
+  distance[source] = 0;
+  paths[source] = 1;
+  order.push_back(source);
+  for(size_t head = 0; head < order.size(); ++head) {
+    int32 u = order[head];
+    for(int32 v : graph.OutNeighbors(u)) {
+      if(distance[v] == -1) {
+        distance[v] = distance[u] + 1;
+        order.push_back(v);
+      }
+      if(distance[v] == distance[u] + 1) paths[v] += paths[u];
+    }
+  }
+  // back from the farthest nodes: a node pulls the dependency of the
+  // nodes one level further that its paths lead to, so it only writes
+  // its own entry
+  for(size_t i = order.size(); i-- > 0;) {
+    int32 v = order[i];
+    double sum = 0;
+    for(int32 w : graph.OutNeighbors(v)) {
+      if(distance[w] == distance[v] + 1) {
+        sum += (1 + dependency[w]) / paths[w];
+      }
+    }
+    dependency[v] = paths[v] * sum;
+    if(v != source) scratch->centrality[v] += scale * dependency[v];
+  }
+  for(int32 v : order) {
+    distance[v] = -1;
+    paths[v] = 0;
+    dependency[v] = 0;
+  }
+  order.clear();
+}
+
+std::vector<double> FromSources(const CsrGraph& graph,
+                                const std::vector<int32>& sources,
+                                double scale, ThreadPool* pool) {
+  int64 count = graph.Count();
+  int threads = pool == nullptr ? 1 : pool->size();
+  // made by the threads that use them, so the memory is theirs to touch
+  // first
+  std::vector<std::unique_ptr<Scratch>> scratch(threads);
+  auto run = [&](int thread, int64 begin, int64 end) {
+    if(scratch[thread] == nullptr) scratch[thread].reset(new Scratch(count));
+    for(int64 i = begin; i < end; ++i) {
+      AddDependencies(graph, sources[i], scale, scratch[thread].get());
+    }
+  };
+  ParallelFor(pool, sources.size(), 1, run);
+  std::vector<double> result(count, 0.0);
+  for(const std::unique_ptr<Scratch>& own : scratch) {
+    if(own == nullptr) continue;
+    for(int64 v = 0; v < count; ++v) result[v] += own->centrality[v];
+  }
+  return result;
+}
+
+}  // namespace
+
+std::vector<double> Betweenness(const CsrGraph& graph, ThreadPool* pool) {
+  std::vector<int32> sources(graph.Count());
+  for(int32 s = 0; s < graph.Count(); ++s) sources[s] = s;
+  return FromSources(graph, sources, 1.0, pool);
+}
+
+std::vector<double> ApproximateBetweenness(const CsrGraph& graph,
+                                           int64 samples, unsigned int seed,
+                                           ThreadPool* pool) {
+  int64 count = graph.Count();
+  if(count == 0 || samples <= 0) return std::vector<double>(count, 0.0);
+  uint64_t state = seed;
+  auto random = [&state]() {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return state >> 33;
+  };
+  std::vector<int32> sources(samples);
+  for(int32& source : sources) source = random() % count;
+  return FromSources(graph, sources, static_cast<double>(count) / samples,
+                     pool);
+}
+
+int64 BetweennessSamples(int64 count, double epsilon, double delta) {
+  // the formula would divide by zero or take the log of something that
+  // isn't positive, and there is no bound to promise anyway
+  if(count <= 0 || !(epsilon > 0) || !(delta > 0)) return 0;
+  double samples = std::ceil(std::log(2.0 * count / delta) /
+                             (2 * epsilon * epsilon));
+  // a delta of 2 * count or more needs no samples at all
+  if(!(samples > 0)) return 0;
+  // converting a double past the int64 range is undefined
+  if(samples >= 9223372036854775807.0) {
+    return std::numeric_limits<int64>::max();
+  }
+  return samples;
+}
@@ -0,0 +1,44 @@
+#ifndef BETWEENNESS_H_INCLUDE
+#define BETWEENNESS_H_INCLUDE
+#include<vector>
+#include "csr_graph.hpp"
+#include "thread_pool.hpp"
+
+// Betweenness centrality over a CsrGraph, by dense index: for every node
+// v, the sum over all ordered pairs (s, t) with s != v != t of the
+// fraction of shortest s -> t paths that pass through v. Edges are
+// followed in their direction and all weigh 1.
+//
+// Both functions run Brandes' algorithm from a set of sources: a BFS from
+// s that counts the shortest paths to every node, then one pass back
+// through the nodes in reverse BFS order that adds up every node's share
+// of the paths from s (its dependency). Sources are handed out to the
+// pool one at a time; every thread has its own BFS arrays and its own
+// totals, which are added together at the end, so the threads never
+// write to the same memory. The pool may be nullptr.
+
+// Exact betweenness, every node is a source. O(n * m).
+std::vector<double> Betweenness(const CsrGraph& graph, ThreadPool* pool);
+
+// An estimate from samples sources picked uniformly at random (with
+// replacement), scaled up by Count() / samples, so it estimates the same
+// numbers as Betweenness. The same seed picks the same sources.
+//
+// The dependency of a node on one source is between 0 and n - 2, so by
+// Hoeffding's inequality and a union bound over the nodes, with
+// BetweennessSamples(n, epsilon, delta) samples every estimate is within
+// epsilon * n * (n - 2) of the exact value (epsilon in units of the
+// largest possible betweenness), all at once, with probability at least
+// 1 - delta.
+std::vector<double> ApproximateBetweenness(const CsrGraph& graph,
+                                           int64 samples, unsigned int seed,
+                                           ThreadPool* pool);
+
+// The number of samples for that bound: ceil(ln(2 * count / delta) /
+// (2 * epsilon^2)). It does not grow with the number of edges and only
+// logarithmically with the number of nodes, so epsilon = 0.01 and delta =
+// 0.1 take about 119000 samples for a billion nodes. Returns 0 if count,
+// epsilon or delta is not positive, and saturates at the largest int64.
+int64 BetweennessSamples(int64 count, double epsilon, double delta);
+
+#endif
@@ -0,0 +1,299 @@
+#include "bfs.hpp"
+#include<vector>
+#include<algorithm>
+#include<atomic>
+#include<memory>
+#include<cstdint>
+
+namespace {
+
+// the switching heuristics from the paper, their suggested values
+const int64 kTopDownToBottomUp = 14;
+const int64 kBottomUpToTopDown = 24;
+
+// how many searches fit in one MS-BFS traversal, one per mask bit
+const int kBatchWidth = 64;
+
+// One level of a multi-source traversal: the nodes first reached at this
+// level and which searches reached them, sorted by node so we can binary
+// search it when putting the paths back together.
+struct LevelEntry {
+  int32 node;
+  uint64_t searches;
+  bool operator<(const LevelEntry& other) const { return node < other.node; }
+};
+
+// Does search number bit first reach node at this level?
+bool ReachedAt(const std::vector<LevelEntry>& level, int32 node, int bit) {
+  LevelEntry key = {node, 0};
+  auto it = std::lower_bound(level.begin(), level.end(), key);
+  return it != level.end() && it->node == node &&
+    (it->searches >> bit & 1);
+}
+
+// A query of a batch: its index in the caller's list and the bit of its
+// source.
+struct BatchQuery {
+  size_t query;
+  int bit;
+};
+
+// Runs one MS-BFS over up to kBatchWidth distinct sources (dense
+// indices), and fills in the paths of the batch's queries. targets is
+// indexed by query, but only the entries of queries in batch are looked
+// at, so a batch costs the same however many queries there are in all.
+// seen and next are scratch arrays of Count() zeros and are left that
+// way.
+void RunBatch(const CsrGraph& graph, const std::vector<int32>& sources,
+              const std::vector<int32>& targets,
+              const std::vector<BatchQuery>& batch,
+              std::vector<uint64_t>* seen, std::vector<uint64_t>* next,
+              std::vector<std::vector<int64>>* paths) {
+  // which searches still have a query waiting on them. Once a search has
+  // found all its targets we stop pushing its bit around.
+  std::vector<int> waiting(sources.size(), 0);
+  for(const BatchQuery& entry : batch) ++waiting[entry.bit];
+  uint64_t active = 0;
+  std::vector<std::vector<LevelEntry>> levels(1);
+  for(size_t bit = 0; bit < sources.size(); ++bit) {
+    uint64_t mask = uint64_t(1) << bit;
+    active |= mask;
+    levels[0].push_back({sources[bit], mask});
+    (*seen)[sources[bit]] = mask;
+  }
+  std::sort(levels[0].begin(), levels[0].end());
+  // level at which the target of batch[i] was found, -1 while it wasn't,
+  // and the positions in batch of the ones not found yet
+  std::vector<int32> found_at(batch.size(), -1);
+  std::vector<size_t> pending(batch.size());
+  for(size_t i = 0; i < batch.size(); ++i) pending[i] = i;
+  std::vector<int32> touched;
+  for(int32 depth = 0; ; ++depth) {
+    // see which queries got answered by this level
+    size_t kept = 0;
+    for(size_t i : pending) {
+      int bit = batch[i].bit;
+      if((*seen)[targets[batch[i].query]] >> bit & 1) {
+        found_at[i] = depth;
+        if(--waiting[bit] == 0) active &= ~(uint64_t(1) << bit);
+      } else {
+        pending[kept++] = i;
+      }
+    }
+    pending.resize(kept);
+    if(active == 0) break;
+    // push every search one step further. All the searches that reached u
+    // at this level cross each edge out of u in a single OR.
+    touched.clear();
+    for(const LevelEntry& entry : levels[depth]) {
+      uint64_t searches = entry.searches & active;
+      if(searches == 0) continue;
+      for(int32 v : graph.OutNeighbors(entry.node)) {
+        uint64_t fresh = searches & ~(*seen)[v];
+        if(fresh == 0) continue;
+        if((*next)[v] == 0) touched.push_back(v);
+        (*next)[v] |= fresh;
+      }
+    }
+    if(touched.empty()) break;
+    std::sort(touched.begin(), touched.end());
+    levels.emplace_back();
+    std::vector<LevelEntry>& level = levels.back();
+    level.reserve(touched.size());
+    for(int32 v : touched) {
+      level.push_back({v, (*next)[v]});
+      (*seen)[v] |= (*next)[v];
+      (*next)[v] = 0;
+    }
+  }
+  // Paths: the target of a query answered at level d has a predecessor
+  // that the same search reached at level d - 1, and so on back to the
+  // source.
+  for(size_t i = 0; i < batch.size(); ++i) {
+    if(found_at[i] == -1) continue;
+    int bit = batch[i].bit;
+    std::vector<int64>& path = (*paths)[batch[i].query];
+    path.resize(found_at[i] + 1);
+    int32 current = targets[batch[i].query];
+    path[found_at[i]] = graph.IdOf(current);
+    for(int32 depth = found_at[i] - 1; depth >= 0; --depth) {
+      for(int32 u : graph.InNeighbors(current)) {
+        if(ReachedAt(levels[depth], u, bit)) {
+          current = u;
+          break;
+        }
+      }
+      path[depth] = graph.IdOf(current);
+    }
+  }
+  // hand the scratch array back clean
+  for(const std::vector<LevelEntry>& level : levels) {
+    for(const LevelEntry& entry : level) (*seen)[entry.node] = 0;
+  }
+}
+
+}  // namespace
+
+BfsTree DirectionOptimizingBfs(const CsrGraph& graph, int32 source) {
+  int64 count = graph.Count();
+  BfsTree tree;
+  tree.distance.assign(count, -1);
+  tree.parent.assign(count, -1);
+  tree.distance[source] = 0;
+  tree.parent[source] = source;
+  // the frontier as a list for top-down steps, and as a bitmap for
+  // bottom-up steps (which need "is u in the frontier?")
+  std::vector<int32> frontier(1, source);
+  std::vector<int32> next;
+  std::vector<bool> in_frontier(count, false);
+  // edges we would look at in a bottom-up step: the incoming edges of
+  // every node we have not reached yet
+  int64 unexplored_edges = graph.EdgeCount() - graph.InDegree(source);
+  bool bottom_up = false;
+  for(int32 level = 0; !frontier.empty(); ++level) {
+    int64 frontier_edges = 0;
+    for(int32 u : frontier) frontier_edges += graph.OutDegree(u);
+    if(!bottom_up) {
+      bottom_up = frontier_edges * kTopDownToBottomUp > unexplored_edges;
+    } else {
+      bottom_up = static_cast<int64>(frontier.size()) * kBottomUpToTopDown >
+        count;
+    }
+    next.clear();
+    if(bottom_up) {
+      for(int32 u : frontier) in_frontier[u] = true;
+      for(int32 v = 0; v < count; ++v) {
+        if(tree.distance[v] != -1) continue;
+        for(int32 u : graph.InNeighbors(v)) {
+          if(in_frontier[u]) {
+            // one parent is enough, no need to look at the other edges
+            tree.distance[v] = level + 1;
+            tree.parent[v] = u;
+            next.push_back(v);
+            break;
+          }
+        }
+      }
+      for(int32 u : frontier) in_frontier[u] = false;
+    } else {
+      for(int32 u : frontier) {
+        for(int32 v : graph.OutNeighbors(u)) {
+          if(tree.distance[v] == -1) {
+            tree.distance[v] = level + 1;
+            tree.parent[v] = u;
+            next.push_back(v);
+          }
+        }
+      }
+    }
+    for(int32 v : next) unexplored_edges -= graph.InDegree(v);
+    frontier.swap(next);
+  }
+  return tree;
+}
+
+BfsTree ParallelBfs(const CsrGraph& graph, int32 source, ThreadPool* pool) {
+  if(pool == nullptr) return DirectionOptimizingBfs(graph, source);
+  int64 count = graph.Count();
+  BfsTree tree;
+  tree.distance.assign(count, -1);
+  tree.parent.assign(count, -1);
+  tree.distance[source] = 0;
+  tree.parent[source] = source;
+  // one bit per node. Whoever flips a node's bit from 0 to 1 owns it and
+  // is the only one to write its distance and parent, so those can stay
+  // plain arrays
+  int64 words = (count + 63) / 64;
+  std::unique_ptr<std::atomic<uint64_t>[]> visited(
+    new std::atomic<uint64_t>[words]());
+  visited[source / 64] = uint64_t(1) << (source % 64);
+  std::vector<std::vector<int32>> local_next(pool->size());
+  std::vector<int32> frontier(1, source);
+  for(int32 level = 0; !frontier.empty(); ++level) {
+    pool->ParallelFor(frontier.size(), 64,
+                      [&](int thread, int64 begin, int64 end) {
+      std::vector<int32>& next = local_next[thread];
+      for(int64 i = begin; i < end; ++i) {
+        int32 u = frontier[i];
+        for(int32 v : graph.OutNeighbors(u)) {
+          std::atomic<uint64_t>& word = visited[v / 64];
+          uint64_t bit = uint64_t(1) << (v % 64);
+          // a plain load first, most neighbors are already visited and
+          // that is much cheaper than a read-modify-write
+          if(word.load(std::memory_order_relaxed) & bit) continue;
+          if(word.fetch_or(bit, std::memory_order_relaxed) & bit) continue;
+          tree.distance[v] = level + 1;
+          tree.parent[v] = u;
+          next.push_back(v);
+        }
+      }
+    });
+    frontier.clear();
+    for(std::vector<int32>& next : local_next) {
+      frontier.insert(frontier.end(), next.begin(), next.end());
+      next.clear();
+    }
+  }
+  return tree;
+}
+
+std::vector<std::vector<int64>> BatchShortestPaths(
+  const CsrGraph& graph, const std::vector<std::pair<int64, int64>>& queries) {
+  std::vector<std::vector<int64>> paths(queries.size());
+  std::vector<int32> targets(queries.size(), -1);
+  // group the queries by source, every distinct source needs one bit
+  std::vector<std::pair<int32, int>> by_source;
+  for(size_t q = 0; q < queries.size(); ++q) {
+    int32 source = graph.IndexOf(queries[q].first);
+    targets[q] = graph.IndexOf(queries[q].second);
+    if(source == -1 || targets[q] == -1) continue;
+    by_source.push_back(std::make_pair(source, q));
+  }
+  std::sort(by_source.begin(), by_source.end());
+  std::vector<uint64_t> seen(graph.Count(), 0);
+  std::vector<uint64_t> next(graph.Count(), 0);
+  std::vector<BatchQuery> batch;
+  std::vector<int32> sources;
+  size_t i = 0;
+  while(i < by_source.size()) {
+    // take the next kBatchWidth distinct sources and all their queries
+    sources.clear();
+    batch.clear();
+    for(; i < by_source.size(); ++i) {
+      if(sources.empty() || sources.back() != by_source[i].first) {
+        if(sources.size() == kBatchWidth) break;
+        sources.push_back(by_source[i].first);
+      }
+      batch.push_back({static_cast<size_t>(by_source[i].second),
+                       static_cast<int>(sources.size()) - 1});
+    }
+    RunBatch(graph, sources, targets, batch, &seen, &next, &paths);
+  }
+  return paths;
+}
+
+std::vector<int64> ReachableFrom(const CsrGraph& graph, int64 from) {
+  std::vector<int64> result;
+  int32 source = graph.IndexOf(from);
+  if(source == -1) return result;
+  BfsTree tree = DirectionOptimizingBfs(graph, source);
+  // indices are handed out in id order, so this comes out sorted
+  for(int32 v = 0; v < graph.Count(); ++v) {
+    if(tree.distance[v] != -1) result.push_back(graph.IdOf(v));
+  }
+  return result;
+}
+
+std::vector<int64> PathTo(const CsrGraph& graph, const BfsTree& tree,
+                          int32 target) {
+  std::vector<int64> result;
+  if(tree.parent[target] == -1) return result;
+  int32 current = target;
+  while(tree.parent[current] != current) {
+    result.push_back(graph.IdOf(current));
+    current = tree.parent[current];
+  }
+  result.push_back(graph.IdOf(current));
+  std::reverse(result.begin(), result.end());
+  return result;
+}
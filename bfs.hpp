@@ -0,0 +1,59 @@
+#ifndef BFS_H_INCLUDE
+#define BFS_H_INCLUDE
+#include<vector>
+#include<utility>
+#include "csr_graph.hpp"
+#include "thread_pool.hpp"
+
+// Whole graph breadth first traversals over a CsrGraph. Everything in here
+// works on dense indices (see CsrGraph::IndexOf / IdOf).
+
+// The result of a single source traversal, indexed by dense index.
+// distance[v] is the number of edges on a shortest path from the source,
+// or -1 if v can't be reached. parent[v] is the node before v on one such
+// path; the source is its own parent and unreachable nodes have -1.
+struct BfsTree {
+  std::vector<int32> distance;
+  std::vector<int32> parent;
+};
+
+// Direction optimizing BFS (Beamer, Asanovic and Patterson). Small
+// frontiers are expanded top-down over outgoing edges as usual. Once the
+// frontier's edges outnumber the edges left to check by a factor of
+// 1 / kTopDownToBottomUp, every unvisited node instead looks through its
+// incoming edges for a parent in the frontier and stops at the first one
+// it finds, which skips most edge checks in the fat middle levels of low
+// diameter graphs. It goes back to top-down once the frontier shrinks to
+// under Count() / kBottomUpToTopDown nodes.
+BfsTree DirectionOptimizingBfs(const CsrGraph& graph, int32 source);
+
+// Level synchronous BFS that spreads every level over the threads of the
+// pool. Nodes are claimed through an atomic visited bitmap, so each one is
+// discovered by exactly one thread, and every thread collects what it
+// discovers in its own next-frontier buffer; the buffers are glued
+// together between levels. Gives the same distances as
+// DirectionOptimizingBfs, but the parents may differ between runs. With
+// a nullptr pool it simply is DirectionOptimizingBfs.
+BfsTree ParallelBfs(const CsrGraph& graph, int32 source, ThreadPool* pool);
+
+// Answers a whole batch of ShortestPath queries, given as (from, to) id
+// pairs, with a few bit-parallel traversals (MS-BFS, Then et al.) instead
+// of one search per query. Up to 64 distinct sources share a traversal:
+// every node carries a 64 bit mask of the searches that have reached it,
+// so one scan of an edge advances all of them at once, and queries with
+// the same source share a bit. Returns one path per query, in order, with
+// the same contract as Graph::ShortestPath.
+std::vector<std::vector<int64>> BatchShortestPaths(
+  const CsrGraph& graph, const std::vector<std::pair<int64, int64>>& queries);
+
+// Ids of every node that can be reached from the node with this id, the
+// node itself included, in increasing id order. Empty if there is no such
+// node.
+std::vector<int64> ReachableFrom(const CsrGraph& graph, int64 from);
+
+// Walks the parents in tree back from target. Returns the ids on the path
+// from the source to target, or an empty vector if target wasn't reached.
+std::vector<int64> PathTo(const CsrGraph& graph, const BfsTree& tree,
+                          int32 target);
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef BIDIRECTIONAL_SEARCH_H_INCLUDE
+#define BIDIRECTIONAL_SEARCH_H_INCLUDE
+#include<vector>
+#include<algorithm>
+#include "flat_id_map.hpp"
+
+// Shortest path by breadth first search from both ends at once. Every
+// round expands one whole level of whichever side has the smaller
+// frontier: forward from source over outgoing edges, or backward from
+// target over incoming edges. The searches stop as soon as they touch.
+// On graphs where the ball around a node grows quickly this explores
+// roughly 2 * b^(d/2) nodes instead of b^d.
+//
+// Id is whatever names a node (graph ids, dense indices, ...).
+// for_each_successor(u, f) must call f(v) for every edge u -> v and
+// for_each_predecessor(v, f) must call f(u) for every edge u -> v.
+// Returns the nodes on the path, source and target included, or an empty
+// vector if there is no path. Both ends are assumed to exist.
+//
+// Each side keeps track of how it reached a node: forward_parent maps v
+// to the node before v on the way from the source, backward_parent to
+// the node after v on the way to the target. The ends point to
+// themselves. These double as the visited sets. They must start out
+// empty and can be anything with FlatIdMap's Insert, Contains and at,
+// like a flat array when the ids are dense indices.
+template<typename Id, typename Successors, typename Predecessors,
+         typename ParentMap>
+std::vector<Id> BidirectionalSearch(Id source, Id target,
+                                    Successors for_each_successor,
+                                    Predecessors for_each_predecessor,
+                                    ParentMap* forward_parent_map,
+                                    ParentMap* backward_parent_map) {
+  std::vector<Id> result;
+  if(source == target) {
+    result.push_back(source);
+    return result;
+  }
+  ParentMap& forward_parent = *forward_parent_map;
+  ParentMap& backward_parent = *backward_parent_map;
+  forward_parent.Insert(source, source);
+  backward_parent.Insert(target, target);
+  std::vector<Id> forward_frontier(1, source);
+  std::vector<Id> backward_frontier(1, target);
+  std::vector<Id> next;
+  bool met = false;
+  Id meeting = source;
+  // Why the first meeting is a shortest path: before this round the two
+  // visited sets were disjoint, so the distance is more than
+  // forward_depth + backward_depth. Every node found in this round is
+  // forward_depth + 1 steps from one end and at most backward_depth steps
+  // from the other, so it is exactly on a shortest path.
+  while(!met && !forward_frontier.empty() && !backward_frontier.empty()) {
+    bool forward = forward_frontier.size() <= backward_frontier.size();
+    std::vector<Id>& frontier = forward ? forward_frontier : backward_frontier;
+    ParentMap& mine = forward ? forward_parent : backward_parent;
+    ParentMap& theirs = forward ? backward_parent : forward_parent;
+    next.clear();
+    for(size_t i = 0; i < frontier.size() && !met; ++i) {
+      Id current = frontier[i];
+      auto visit = [&](Id neighbor) {
+        if(met || !mine.Insert(neighbor, current)) return;
+        if(theirs.Contains(neighbor)) {
+          met = true;
+          meeting = neighbor;
+        }
+        next.push_back(neighbor);
+      };
+      if(forward) {
+        for_each_successor(current, visit);
+      } else {
+        for_each_predecessor(current, visit);
+      }
+    }
+    frontier.swap(next);
+  }
+  if(!met) return result;
+  // walk back to the source, flip that half, then walk on to the target
+  for(Id current = meeting; current != source;
+      current = forward_parent.at(current)) {
+    result.push_back(current);
+  }
+  result.push_back(source);
+  std::reverse(result.begin(), result.end());
+  for(Id current = meeting; current != target; ) {
+    current = backward_parent.at(current);
+    result.push_back(current);
+  }
+  return result;
+}
+
+// The same, with the parents kept in hash tables, for ids that can be
+// anything.
+template<typename Id, typename Successors, typename Predecessors>
+std::vector<Id> BidirectionalSearch(Id source, Id target,
+                                    Successors for_each_successor,
+                                    Predecessors for_each_predecessor) {
+  FlatIdMap<Id> forward_parent;
+  FlatIdMap<Id> backward_parent;
+  return BidirectionalSearch(source, target, for_each_successor,
+                             for_each_predecessor, &forward_parent,
+                             &backward_parent);
+}
+
+#endif
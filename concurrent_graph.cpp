@@ -0,0 +1,188 @@
+#include "concurrent_graph.hpp"
+#include "bidirectional_search.hpp"
+#include<vector>
+#include<memory>
+#include<mutex>
+#include<shared_mutex>
+#include<algorithm>
+#include<utility>
+
+namespace {
+
+const int kDefaultShards = 64;
+
+typedef std::shared_timed_mutex SharedMutex;
+typedef std::shared_lock<SharedMutex> ReadLock;
+typedef std::unique_lock<SharedMutex> WriteLock;
+
+}  // namespace
+
+ConcurrentGraph::ConcurrentGraph() : ConcurrentGraph(kDefaultShards) {}
+
+ConcurrentGraph::ConcurrentGraph(int shards) :
+  next_id_(0), count_(0), version_(0) {
+  for(int i = 0; i < std::max(shards, 1); ++i) {
+    shards_.emplace_back(new Shard());
+  }
+}
+
+int ConcurrentGraph::ShardOf(int64 id) const {
+  // mix the id, consecutive ids should not all pile into one shard
+  uint64_t h = static_cast<uint64_t>(id) * 0x9e3779b97f4a7c15ULL;
+  return (h >> 32) % shards_.size();
+}
+
+int64 ConcurrentGraph::AddNode() {
+  // same idea as Graph::AddNode, keep trying ids until one is free, but
+  // the counter is shared by all the threads
+  while(true) {
+    int64 id = next_id_.fetch_add(1);
+    Shard& shard = *shards_[ShardOf(id)];
+    WriteLock lock(shard.mutex);
+    if(shard.nodes.Insert(id, Node())) {
+      ++count_;
+      ++version_;
+      return id;
+    }
+  }
+}
+
+int64 ConcurrentGraph::AddNode(int64 id) {
+  Shard& shard = *shards_[ShardOf(id)];
+  WriteLock lock(shard.mutex);
+  if(shard.nodes.Insert(id, Node())) {
+    ++count_;
+    ++version_;
+  }
+  return id;
+}
+
+int64 ConcurrentGraph::Count() {
+  return count_;
+}
+
+bool ConcurrentGraph::Contains(int64 id) {
+  Shard& shard = *shards_[ShardOf(id)];
+  ReadLock lock(shard.mutex);
+  return shard.nodes.Contains(id);
+}
+
+void ConcurrentGraph::Connect(int64 from, int64 to) {
+  int first = ShardOf(from);
+  int second = ShardOf(to);
+  // always lock the lower shard first, and the same shard only once
+  WriteLock first_lock(shards_[std::min(first, second)]->mutex);
+  WriteLock second_lock;
+  if(first != second) {
+    second_lock = WriteLock(shards_[std::max(first, second)]->mutex);
+  }
+  Node* source = shards_[first]->nodes.Find(from);
+  Node* target = shards_[second]->nodes.Find(to);
+  if(source == nullptr || target == nullptr) return;
+  if(source->outgoing.Insert(to, Adjacency::kDefaultHashThreshold)) {
+    target->incoming.Insert(from, Adjacency::kDefaultHashThreshold);
+    ++version_;
+  }
+}
+
+void ConcurrentGraph::Disconnect(int64 from, int64 to) {
+  int first = ShardOf(from);
+  int second = ShardOf(to);
+  WriteLock first_lock(shards_[std::min(first, second)]->mutex);
+  WriteLock second_lock;
+  if(first != second) {
+    second_lock = WriteLock(shards_[std::max(first, second)]->mutex);
+  }
+  Node* source = shards_[first]->nodes.Find(from);
+  Node* target = shards_[second]->nodes.Find(to);
+  if(source == nullptr || target == nullptr) return;
+  if(source->outgoing.Erase(to)) {
+    target->incoming.Erase(from);
+    ++version_;
+  }
+}
+
+bool ConcurrentGraph::IsConnected(int64 from, int64 to) {
+  Shard& shard = *shards_[ShardOf(from)];
+  ReadLock lock(shard.mutex);
+  const Node* source = shard.nodes.Find(from);
+  return source != nullptr && source->outgoing.Contains(to);
+}
+
+void ConcurrentGraph::Delete(int64 node) {
+  // the neighbors can be anywhere, so take every shard, in order
+  std::vector<WriteLock> locks;
+  locks.reserve(shards_.size());
+  for(auto& shard : shards_) locks.emplace_back(shard->mutex);
+  FlatIdMap<Node>& home = shards_[ShardOf(node)]->nodes;
+  Node* deleted = home.Find(node);
+  if(deleted == nullptr) return;
+  deleted->incoming.ForEach([this, node](int64 id) {
+    Node* neighbor = shards_[ShardOf(id)]->nodes.Find(id);
+    if(neighbor != nullptr) neighbor->outgoing.Erase(node);
+  });
+  deleted->outgoing.ForEach([this, node](int64 id) {
+    Node* neighbor = shards_[ShardOf(id)]->nodes.Find(id);
+    if(neighbor != nullptr) neighbor->incoming.Erase(node);
+  });
+  home.Erase(node);
+  --count_;
+  ++version_;
+}
+
+template<typename F>
+void ConcurrentGraph::ForEachNeighbor(int64 id, bool outgoing, F f) {
+  Shard& shard = *shards_[ShardOf(id)];
+  ReadLock lock(shard.mutex);
+  const Node* node = shard.nodes.Find(id);
+  // it may have been deleted since we saw it
+  if(node == nullptr) return;
+  (outgoing ? node->outgoing : node->incoming).ForEach(f);
+}
+
+std::vector<int64> ConcurrentGraph::ShortestPath(int64 from, int64 to) {
+  if(!Contains(from) || !Contains(to)) return std::vector<int64>();
+  // f only touches the search's own bookkeeping, so it is fine to call it
+  // with the shard's read lock held
+  auto successors = [this](int64 id, auto&& f) {
+    ForEachNeighbor(id, true, f);
+  };
+  auto predecessors = [this](int64 id, auto&& f) {
+    ForEachNeighbor(id, false, f);
+  };
+  return BidirectionalSearch(from, to, successors, predecessors);
+}
+
+std::shared_ptr<const CsrGraph> ConcurrentGraph::Snapshot() {
+  std::shared_ptr<const Published> current = std::atomic_load(&snapshot_);
+  // the common case: nothing changed, hand out the one we have
+  if(current != nullptr && current->version == version_) return current->graph;
+  std::lock_guard<std::mutex> rebuild(snapshot_mutex_);
+  // somebody else may have rebuilt it while we waited
+  current = std::atomic_load(&snapshot_);
+  if(current != nullptr && current->version == version_) return current->graph;
+  std::vector<int64> nodes;
+  std::vector<std::pair<int64, int64>> edges;
+  auto fresh = std::make_shared<Published>();
+  {
+    // holding every read lock at once is what makes this one consistent
+    // state rather than a smear of several
+    std::vector<ReadLock> locks;
+    locks.reserve(shards_.size());
+    for(auto& shard : shards_) locks.emplace_back(shard->mutex);
+    fresh->version = version_;
+    nodes.reserve(count_);
+    for(auto& shard : shards_) {
+      for(auto& kv : shard->nodes) {
+        nodes.push_back(kv.first);
+        kv.second.outgoing.ForEach([&](int64 to) {
+          edges.push_back(std::make_pair(kv.first, to));
+        });
+      }
+    }
+  }
+  fresh->graph = std::make_shared<const CsrGraph>(
+    CsrGraph::FromEdges(nodes, edges));
+  std::atomic_store(&snapshot_, std::shared_ptr<const Published>(fresh));
+  return fresh->graph;
+}
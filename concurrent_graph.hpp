@@ -0,0 +1,90 @@
+#ifndef CONCURRENT_GRAPH_H_INCLUDE
+#define CONCURRENT_GRAPH_H_INCLUDE
+#include<vector>
+#include<memory>
+#include<atomic>
+#include<mutex>
+#include<shared_mutex>
+#include "flat_id_map.hpp"
+#include "adjacency.hpp"
+#include "csr_graph.hpp"
+
+// A Graph that any number of threads can use at the same time, without one
+// big lock around everything.
+//
+// The nodes are split into shards by id, each with its own reader-writer
+// lock, so operations on different shards never wait for each other and
+// reads of the same shard only wait for writes. Connect and Disconnect
+// lock the two shards involved, always the lower numbered one first, so
+// two of them can't deadlock. Delete is the one slow path: it has to
+// reach into the shards of all the neighbors, so it locks every shard.
+//
+// For heavy read traffic, Snapshot() hands out an immutable CsrGraph of
+// the current state that can be queried with no locking at all. It is
+// rebuilt lazily, only when somebody asks after the graph has changed.
+class ConcurrentGraph {
+ public:
+  // An empty graph with a default number of shards.
+  ConcurrentGraph();
+  // An empty graph split into this many shards. More shards means less
+  // contention but a slower Delete and Snapshot.
+  explicit ConcurrentGraph(int shards);
+
+  // Same as the Graph methods of the same name, only thread safe.
+  int64 AddNode();
+  int64 AddNode(int64 id);
+  int64 Count();
+  bool Contains(int64 id);
+  void Connect(int64 from, int64 to);
+  void Disconnect(int64 from, int64 to);
+  bool IsConnected(int64 from, int64 to);
+  void Delete(int64 node);
+
+  // Bidirectional BFS like Graph::ShortestPath. Each step locks just the
+  // shard of the node it expands, so writers keep going during the
+  // search. The flip side is that the search can see some edits and not
+  // others; run the query on Snapshot() if it needs one consistent state.
+  std::vector<int64> ShortestPath(int64 from, int64 to);
+
+  // Returns an immutable snapshot of the graph as of some moment during
+  // the call. Queries on it take no locks and never wait for writers. Two
+  // calls with no writes in between return the same snapshot.
+  std::shared_ptr<const CsrGraph> Snapshot();
+
+ private:
+  struct Node {
+    Adjacency outgoing;
+    Adjacency incoming;
+  };
+
+  struct Shard {
+    std::shared_timed_mutex mutex;
+    FlatIdMap<Node> nodes;
+  };
+
+  // a snapshot together with the version it was taken at, published as
+  // one pointer so readers never see one without the other
+  struct Published {
+    std::shared_ptr<const CsrGraph> graph;
+    int64 version;
+  };
+
+  int ShardOf(int64 id) const;
+
+  // Calls f(v) for every edge id -> v (outgoing) or v -> id (!outgoing),
+  // under the shard's read lock.
+  template<typename F>
+  void ForEachNeighbor(int64 id, bool outgoing, F f);
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+  std::atomic<int64> next_id_;
+  std::atomic<int64> count_;
+  // bumped by every change, so Snapshot can tell if its copy is stale
+  std::atomic<int64> version_;
+  // only one thread rebuilds the snapshot at a time
+  std::mutex snapshot_mutex_;
+  // read and written with std::atomic_load / std::atomic_store
+  std::shared_ptr<const Published> snapshot_;
+};
+
+#endif
@@ -0,0 +1,298 @@
+#include "csr_graph.hpp"
+#include "bidirectional_search.hpp"
+#include "shortest_paths.hpp"
+#include<vector>
+#include<algorithm>
+#include<memory>
+#include<limits>
+#include<iterator>
+
+namespace {
+
+// Parents for BidirectionalSearch over dense indices: a flat array of
+// Count() entries, -1 for nodes not reached, instead of a hash table. The
+// array is the calling thread's and is kept for its next search; only the
+// entries this search set are put back to -1 when it's done, so a short
+// search on a huge graph doesn't pay for clearing all of it.
+class DenseParents {
+ public:
+  DenseParents(std::vector<int32>* parent, int64 count) : parent_(*parent) {
+    if(static_cast<int64>(parent_.size()) < count) {
+      parent_.resize(count, -1);
+    }
+  }
+  ~DenseParents() {
+    for(int32 index : reached_) parent_[index] = -1;
+  }
+  DenseParents(const DenseParents&) = delete;
+  DenseParents& operator=(const DenseParents&) = delete;
+
+  bool Insert(int32 index, int32 parent) {
+    if(parent_[index] != -1) return false;
+    parent_[index] = parent;
+    reached_.push_back(index);
+    return true;
+  }
+  bool Contains(int32 index) const { return parent_[index] != -1; }
+  int32 at(int32 index) const { return parent_[index]; }
+
+ private:
+  std::vector<int32>& parent_;
+  std::vector<int32> reached_;
+};
+
+}  // namespace
+
+CsrGraph::CsrGraph() :
+  CsrGraph(std::unique_ptr<Storage>(new Storage())) {}
+
+CsrGraph::CsrGraph(std::unique_ptr<Storage> storage) {
+  // an empty graph still has the one trailing offset
+  if(storage->out_offsets.empty()) storage->out_offsets.push_back(0);
+  if(storage->in_offsets.empty()) storage->in_offsets.push_back(0);
+  count_ = storage->ids.size();
+  edge_count_ = storage->out_targets.size();
+  ids_ = storage->ids.data();
+  out_offsets_ = storage->out_offsets.data();
+  out_targets_ = storage->out_targets.data();
+  in_offsets_ = storage->in_offsets.data();
+  in_targets_ = storage->in_targets.data();
+  out_weights_ = storage->out_weights.empty() ?
+    nullptr : storage->out_weights.data();
+  in_weights_ = storage->in_weights.empty() ?
+    nullptr : storage->in_weights.data();
+  owner_ = std::shared_ptr<const Storage>(std::move(storage));
+}
+
+CsrGraph CsrGraph::FromEdges(
+  const std::vector<std::pair<int64, int64>>& edges) {
+  return FromEdges(std::vector<int64>(), edges);
+}
+
+CsrGraph CsrGraph::FromEdges(
+  const std::vector<int64>& nodes,
+  const std::vector<std::pair<int64, int64>>& edges) {
+  std::unique_ptr<Storage> storage(new Storage());
+  // the nodes are exactly the ids that show up, in increasing order
+  std::vector<int64>& ids = storage->ids;
+  ids.reserve(nodes.size() + edges.size() * 2);
+  ids.insert(ids.end(), nodes.begin(), nodes.end());
+  for(const std::pair<int64, int64>& edge : edges) {
+    ids.push_back(edge.first);
+    ids.push_back(edge.second);
+  }
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+  ids.shrink_to_fit();
+  int64 count = ids.size();
+  FlatIdMap<int32> index_of;
+  index_of.Reserve(count);
+  for(int32 i = 0; i < count; ++i) {
+    index_of.Insert(ids[i], i);
+  }
+  // counting sort of the edges by source
+  std::vector<int64>& offsets = storage->out_offsets;
+  offsets.assign(count + 1, 0);
+  for(const std::pair<int64, int64>& edge : edges) {
+    ++offsets[index_of.at(edge.first) + 1];
+  }
+  for(int64 i = 0; i < count; ++i) {
+    offsets[i + 1] += offsets[i];
+  }
+  std::vector<int32>& targets = storage->out_targets;
+  targets.resize(edges.size());
+  std::vector<int64> fill(offsets.begin(), offsets.end() - 1);
+  for(const std::pair<int64, int64>& edge : edges) {
+    targets[fill[index_of.at(edge.first)]++] = index_of.at(edge.second);
+  }
+  // sort every row and squeeze out the duplicates, moving the rows down
+  // over the gaps as we go
+  int64 write = 0;
+  for(int64 i = 0; i < count; ++i) {
+    auto begin = targets.begin() + offsets[i];
+    auto end = targets.begin() + offsets[i + 1];
+    std::sort(begin, end);
+    end = std::unique(begin, end);
+    offsets[i] = write;
+    write = std::copy(begin, end, targets.begin() + write) - targets.begin();
+  }
+  offsets[count] = write;
+  targets.resize(write);
+  targets.shrink_to_fit();
+  Transpose(count, offsets.data(), targets.data(), nullptr,
+            &storage->in_offsets, &storage->in_targets, nullptr);
+  return CsrGraph(std::move(storage));
+}
+
+void CsrGraph::Transpose(int64 count, const int64* out_offsets,
+                         const int32* out_targets, const double* out_weights,
+                         std::vector<int64>* in_offsets,
+                         std::vector<int32>* in_targets,
+                         std::vector<double>* in_weights) {
+  in_offsets->assign(count + 1, 0);
+  int64 edges = out_offsets[count];
+  for(int64 e = 0; e < edges; ++e) {
+    ++(*in_offsets)[out_targets[e] + 1];
+  }
+  for(int64 i = 0; i < count; ++i) {
+    (*in_offsets)[i + 1] += (*in_offsets)[i];
+  }
+  in_targets->resize(edges);
+  if(out_weights != nullptr) in_weights->resize(edges);
+  std::vector<int64> fill(in_offsets->begin(), in_offsets->end() - 1);
+  // sources are visited in increasing order, so every incoming row comes
+  // out sorted without sorting it
+  for(int32 u = 0; u < count; ++u) {
+    for(int64 e = out_offsets[u]; e < out_offsets[u + 1]; ++e) {
+      int64 slot = fill[out_targets[e]]++;
+      (*in_targets)[slot] = u;
+      if(out_weights != nullptr) (*in_weights)[slot] = out_weights[e];
+    }
+  }
+}
+
+CsrGraph CsrGraph::Reversed() const {
+  CsrGraph result = *this;
+  std::swap(result.out_offsets_, result.in_offsets_);
+  std::swap(result.out_targets_, result.in_targets_);
+  std::swap(result.out_weights_, result.in_weights_);
+  return result;
+}
+
+CsrGraph CsrGraph::Symmetrized() const {
+  std::unique_ptr<Storage> storage(new Storage());
+  storage->ids.assign(ids_, ids_ + count_);
+  std::vector<int64>& offsets = storage->out_offsets;
+  std::vector<int32>& targets = storage->out_targets;
+  offsets.reserve(count_ + 1);
+  targets.reserve(edge_count_ * 2);
+  offsets.push_back(0);
+  // both rows are sorted, so their union is a merge
+  for(int32 u = 0; u < count_; ++u) {
+    Neighbors out = OutNeighbors(u);
+    Neighbors in = InNeighbors(u);
+    std::set_union(out.begin(), out.end(), in.begin(), in.end(),
+                   std::back_inserter(targets));
+    offsets.push_back(targets.size());
+  }
+  targets.shrink_to_fit();
+  CsrGraph result(std::move(storage));
+  // every edge goes both ways, the incoming arrays would be a copy
+  result.in_offsets_ = result.out_offsets_;
+  result.in_targets_ = result.out_targets_;
+  return result;
+}
+
+bool CsrGraph::IsWeighted() const {
+  return out_weights_ != nullptr;
+}
+
+int64 CsrGraph::Count() const {
+  return count_;
+}
+
+int64 CsrGraph::EdgeCount() const {
+  return edge_count_;
+}
+
+int32 CsrGraph::IndexOf(int64 id) const {
+  // ids are sorted, so a binary search on a flat array does it
+  const int64* it = std::lower_bound(ids_, ids_ + count_, id);
+  if(it == ids_ + count_ || *it != id) return -1;
+  return it - ids_;
+}
+
+int64 CsrGraph::IdOf(int32 index) const {
+  return ids_[index];
+}
+
+bool CsrGraph::Contains(int64 id) const {
+  return IndexOf(id) != -1;
+}
+
+CsrGraph::Neighbors CsrGraph::OutNeighbors(int32 index) const {
+  return Neighbors(out_targets_ + out_offsets_[index],
+                   out_targets_ + out_offsets_[index + 1]);
+}
+
+CsrGraph::Neighbors CsrGraph::InNeighbors(int32 index) const {
+  return Neighbors(in_targets_ + in_offsets_[index],
+                   in_targets_ + in_offsets_[index + 1]);
+}
+
+int64 CsrGraph::OutDegree(int32 index) const {
+  return out_offsets_[index + 1] - out_offsets_[index];
+}
+
+int64 CsrGraph::InDegree(int32 index) const {
+  return in_offsets_[index + 1] - in_offsets_[index];
+}
+
+const double* CsrGraph::OutWeights(int32 index) const {
+  return out_weights_ == nullptr ? nullptr : out_weights_ + out_offsets_[index];
+}
+
+const double* CsrGraph::InWeights(int32 index) const {
+  return in_weights_ == nullptr ? nullptr : in_weights_ + in_offsets_[index];
+}
+
+bool CsrGraph::IsConnected(int64 from, int64 to) const {
+  int32 u = IndexOf(from);
+  int32 v = IndexOf(to);
+  if(u == -1 || v == -1) return false;
+  // rows are sorted, so this is another binary search
+  Neighbors row = OutNeighbors(u);
+  return std::binary_search(row.begin(), row.end(), v);
+}
+
+// Same bidirectional search as Graph::ShortestPath, but on dense indices,
+// which are translated back to ids at the end, with flat arrays for the
+// parents.
+std::vector<int64> CsrGraph::ShortestPath(int64 from, int64 to) const {
+  std::vector<int64> result;
+  int32 source = IndexOf(from);
+  int32 target = IndexOf(to);
+  if(source == -1 || target == -1) return result;
+  auto successors = [this](int32 u, auto&& f) {
+    for(int32 v : OutNeighbors(u)) f(v);
+  };
+  auto predecessors = [this](int32 v, auto&& f) {
+    for(int32 u : InNeighbors(v)) f(u);
+  };
+  thread_local std::vector<int32> forward_scratch;
+  thread_local std::vector<int32> backward_scratch;
+  DenseParents forward_parent(&forward_scratch, count_);
+  DenseParents backward_parent(&backward_scratch, count_);
+  for(int32 index : BidirectionalSearch(source, target, successors,
+                                        predecessors, &forward_parent,
+                                        &backward_parent)) {
+    result.push_back(ids_[index]);
+  }
+  return result;
+}
+
+double CsrGraph::Weight(int64 from, int64 to) const {
+  int32 u = IndexOf(from);
+  int32 v = IndexOf(to);
+  if(u == -1 || v == -1) return std::numeric_limits<double>::infinity();
+  Neighbors row = OutNeighbors(u);
+  const int32* it = std::lower_bound(row.begin(), row.end(), v);
+  if(it == row.end() || *it != v) return std::numeric_limits<double>::infinity();
+  return out_weights_ == nullptr ? 1.0 : OutWeights(u)[it - row.begin()];
+}
+
+std::vector<int64> CsrGraph::WeightedShortestPath(int64 from,
+                                                  int64 to) const {
+  std::vector<int64> result;
+  int32 source = IndexOf(from);
+  int32 target = IndexOf(to);
+  if(source == -1 || target == -1) return result;
+  WeightedTree tree = Dijkstra(*this, source, target);
+  if(tree.parent[target] == -1) return result;
+  for(int32 v = target; v != source; v = tree.parent[v]) {
+    result.push_back(ids_[v]);
+  }
+  result.push_back(from);
+  std::reverse(result.begin(), result.end());
+  return result;
+}
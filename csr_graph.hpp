@@ -0,0 +1,171 @@
+#ifndef CSR_GRAPH_H_INCLUDE
+#define CSR_GRAPH_H_INCLUDE
+#include<vector>
+#include<utility>
+#include<memory>
+#include<string>
+#include "graph.hpp"
+
+typedef int int32;
+
+// An immutable, compacted snapshot of a Graph, made by Graph::Freeze().
+// Nodes are renumbered with dense indices 0..Count()-1 (in increasing id
+// order) and the edges of every node live in one contiguous, sorted slice
+// of a big targets array (compressed sparse row). It answers the same
+// queries as Graph, but a BFS step is now an array scan instead of a map
+// lookup + pointer chase + hash set walk. Since nothing can change after
+// construction, all the queries are const and safe to run concurrently.
+class CsrGraph {
+  // only the graph knows how to build one of these
+  friend class Graph;
+
+ public:
+  // A read-only range over the dense indices of a node's neighbors, so
+  // callers can just write for(int32 v : graph.OutNeighbors(u))
+  class Neighbors {
+   public:
+    Neighbors(const int32* begin, const int32* end) :
+      begin_(begin), end_(end) {}
+    const int32* begin() const { return begin_; }
+    const int32* end() const { return end_; }
+    int64 size() const { return end_ - begin_; }
+   private:
+    const int32* begin_;
+    const int32* end_;
+  };
+
+  // An empty snapshot.
+  CsrGraph();
+
+  // Builds a snapshot straight from a list of (from, to) edges, without
+  // going through a Graph. Every id that shows up in an edge becomes a
+  // node; repeated edges are only kept once, like Graph::Connect does.
+  static CsrGraph FromEdges(const std::vector<std::pair<int64, int64>>& edges);
+
+  // Same, but every id in nodes becomes a node as well, so nodes without
+  // any edges are not lost.
+  static CsrGraph FromEdges(const std::vector<int64>& nodes,
+                            const std::vector<std::pair<int64, int64>>& edges);
+
+  // Writes the snapshot to a binary file at path (the format is described
+  // in csr_snapshot.hpp), so it can be brought back with OpenSnapshot
+  // instead of being rebuilt. with_incoming says whether to store the
+  // incoming edges too; without them the file is about half the size, but
+  // OpenSnapshot has to rebuild them. Edge weights are stored if the
+  // snapshot has them. Returns false if the file can't be written.
+  bool WriteSnapshot(const std::string& path, bool with_incoming) const;
+
+  // Opens a file written by WriteSnapshot by mapping it into memory. There
+  // is no parsing and no copying: the arrays point straight into the
+  // mapping and the pages are read in as queries touch them, so this
+  // returns right away even for huge graphs. If verify is true, every
+  // checksum and every edge is checked first, which reads the whole file;
+  // only skip that for files you trust. Returns false if the file can't
+  // be mapped or isn't a valid snapshot.
+  static bool OpenSnapshot(const std::string& path, bool verify,
+                           CsrGraph* graph);
+
+  // Returns the transposed graph: every edge u -> v becomes v -> u. This
+  // just swaps which arrays count as outgoing and which as incoming, and
+  // shares them with this snapshot, so it costs nothing and any algorithm
+  // that takes a CsrGraph can run backwards by being handed one.
+  CsrGraph Reversed() const;
+
+  // Returns the graph with edge directions ignored: u -> v is an edge of
+  // the result if u -> v or v -> u is an edge here. Rows are still sorted,
+  // incoming and outgoing are the same arrays, and self loops are kept.
+  // Unlike Reversed this builds new arrays. The result is unweighted.
+  CsrGraph Symmetrized() const;
+
+  // Returns true if the snapshot has edge weights (it was frozen from a
+  // graph with weighted edges). Without them every edge weighs 1.
+  bool IsWeighted() const;
+
+  // Returns the number of nodes in the snapshot.
+  int64 Count() const;
+
+  // Returns the number of edges in the snapshot.
+  int64 EdgeCount() const;
+
+  // Returns true if there's a node with this id.
+  bool Contains(int64 id) const;
+
+  // Returns true if there's a connection from -> to.
+  bool IsConnected(int64 from, int64 to) const;
+
+  // Return the shortest path between two nodes. If no shortest
+  // path exists, return an empty vector. Same contract as
+  // Graph::ShortestPath.
+  std::vector<int64> ShortestPath(int64 from, int64 to) const;
+
+  // Returns the weight of the edge from -> to, or infinity if there is no
+  // such edge.
+  double Weight(int64 from, int64 to) const;
+
+  // Return the path between two nodes with the smallest total weight.
+  // Same contract as Graph::WeightedShortestPath.
+  std::vector<int64> WeightedShortestPath(int64 from, int64 to) const;
+
+  // Translation between node ids and dense indices. IndexOf returns -1 if
+  // there's no node with that id; IdOf expects a valid index.
+  int32 IndexOf(int64 id) const;
+  int64 IdOf(int32 index) const;
+
+  // Neighbors of the node at a dense index, in increasing index order.
+  Neighbors OutNeighbors(int32 index) const;
+  Neighbors InNeighbors(int32 index) const;
+  int64 OutDegree(int32 index) const;
+  int64 InDegree(int32 index) const;
+
+  // Weights of the edges in OutNeighbors(index) / InNeighbors(index), in
+  // the same order, or nullptr if the snapshot is unweighted.
+  const double* OutWeights(int32 index) const;
+  const double* InWeights(int32 index) const;
+
+ private:
+  // The arrays of a snapshot that was built in memory (as opposed to
+  // mapped from a file). Same layout as the pointers below.
+  struct Storage {
+    std::vector<int64> ids;
+    std::vector<int64> out_offsets;
+    std::vector<int32> out_targets;
+    std::vector<int64> in_offsets;
+    std::vector<int32> in_targets;
+    // empty if the graph is unweighted
+    std::vector<double> out_weights;
+    std::vector<double> in_weights;
+  };
+
+  // Fills in the incoming arrays by transposing the outgoing ones. The
+  // weights come along if out_weights is not nullptr.
+  static void Transpose(int64 count, const int64* out_offsets,
+                        const int32* out_targets, const double* out_weights,
+                        std::vector<int64>* in_offsets,
+                        std::vector<int32>* in_targets,
+                        std::vector<double>* in_weights);
+
+  // Takes over storage and points the arrays into it.
+  explicit CsrGraph(std::unique_ptr<Storage> storage);
+
+  // Keeps whatever the arrays point into alive: a Storage, or a mapped
+  // snapshot file (see csr_snapshot.cpp). Shared, so copying a CsrGraph
+  // is cheap and the copies share the arrays (nobody can write to them
+  // anyway).
+  std::shared_ptr<const void> owner_;
+  int64 count_;
+  int64 edge_count_;
+  // ids_[i] is the id of the node with index i. Sorted, so IndexOf is a
+  // binary search.
+  const int64* ids_;
+  // edges of node i are out_targets_[out_offsets_[i] .. out_offsets_[i+1]),
+  // and the same for incoming edges. Offsets have Count() + 1 entries.
+  const int64* out_offsets_;
+  const int32* out_targets_;
+  const int64* in_offsets_;
+  const int32* in_targets_;
+  // parallel to out_targets_ / in_targets_, nullptr if unweighted
+  const double* out_weights_;
+  const double* in_weights_;
+};
+
+#endif
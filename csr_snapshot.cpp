@@ -0,0 +1,263 @@
+#include "csr_snapshot.hpp"
+#include "csr_graph.hpp"
+#include "mapped_file.hpp"
+#include<vector>
+#include<string>
+#include<memory>
+#include<fstream>
+#include<cstring>
+#include<cstddef>
+#include<limits>
+
+namespace {
+
+// What a CsrGraph opened from a file keeps alive: the mapping, plus the
+// incoming edges if the file didn't have them and we had to build them.
+struct MappedSnapshot {
+  std::unique_ptr<MappedFile> file;
+  std::vector<int64> in_offsets;
+  std::vector<int32> in_targets;
+  std::vector<double> in_weights;
+};
+
+// Whether section s is in a file with these flags.
+bool HasSection(int s, uint32_t flags) {
+  bool incoming = flags & kSnapshotHasIncoming;
+  bool weights = flags & kSnapshotHasWeights;
+  switch(s) {
+    case kSectionInOffsets:
+    case kSectionInTargets:
+      return incoming;
+    case kSectionOutWeights:
+      return weights;
+    case kSectionInWeights:
+      return incoming && weights;
+    default:
+      return true;
+  }
+}
+
+uint64_t RoundUp(uint64_t offset) {
+  return (offset + kSnapshotAlignment - 1) / kSnapshotAlignment *
+    kSnapshotAlignment;
+}
+
+// Checks that the section fits in the file, is where it can be read as an
+// array of element_size, and has the size it should.
+bool ValidSection(const SnapshotSection& section, uint64_t expected_bytes,
+                  uint64_t element_size, uint64_t file_size) {
+  return section.bytes == expected_bytes &&
+    section.offset % element_size == 0 &&
+    section.offset >= sizeof(SnapshotHeader) &&
+    section.offset <= file_size &&
+    section.bytes <= file_size - section.offset;
+}
+
+// The full check of one direction of edges: offsets go from 0 up to
+// edge_count without ever going down, and every target is a real node
+// with the rows sorted.
+bool ValidEdges(int64 count, int64 edge_count, const int64* offsets,
+                const int32* targets) {
+  if(offsets[0] != 0 || offsets[count] != edge_count) return false;
+  for(int64 i = 0; i < count; ++i) {
+    if(offsets[i + 1] < offsets[i]) return false;
+    for(int64 e = offsets[i]; e < offsets[i + 1]; ++e) {
+      if(targets[e] < 0 || targets[e] >= count) return false;
+      if(e > offsets[i] && targets[e] <= targets[e - 1]) return false;
+    }
+  }
+  return true;
+}
+
+// Weights must be numbers and not negative, like Dijkstra expects.
+bool ValidWeights(int64 edge_count, const double* weights) {
+  for(int64 e = 0; e < edge_count; ++e) {
+    if(!(weights[e] >= 0)) return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+uint64_t SnapshotChecksum(const char* data, uint64_t bytes) {
+  const uint64_t kPrime = 0x100000001b3ULL;
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  uint64_t i = 0;
+  for(; i + 8 <= bytes; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, data + i, 8);
+    hash = (hash ^ word) * kPrime;
+  }
+  for(; i < bytes; ++i) {
+    hash = (hash ^ static_cast<unsigned char>(data[i])) * kPrime;
+  }
+  return hash;
+}
+
+bool CsrGraph::WriteSnapshot(const std::string& path,
+                             bool with_incoming) const {
+  // what goes in each section, absent ones stay empty
+  const char* data[kSectionCount] = {
+    reinterpret_cast<const char*>(ids_),
+    reinterpret_cast<const char*>(out_offsets_),
+    reinterpret_cast<const char*>(out_targets_),
+    reinterpret_cast<const char*>(in_offsets_),
+    reinterpret_cast<const char*>(in_targets_),
+    reinterpret_cast<const char*>(out_weights_),
+    reinterpret_cast<const char*>(in_weights_)};
+  uint64_t bytes[kSectionCount] = {
+    count_ * sizeof(int64),
+    (count_ + 1) * sizeof(int64),
+    edge_count_ * sizeof(int32),
+    (count_ + 1) * sizeof(int64),
+    edge_count_ * sizeof(int32),
+    edge_count_ * sizeof(double),
+    edge_count_ * sizeof(double)};
+  SnapshotHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+  header.version = kSnapshotVersion;
+  header.flags = (with_incoming ? kSnapshotHasIncoming : 0) |
+    (IsWeighted() ? kSnapshotHasWeights : 0);
+  header.byte_order = kSnapshotByteOrder;
+  header.node_count = count_;
+  header.edge_count = edge_count_;
+  uint64_t offset = RoundUp(sizeof(SnapshotHeader));
+  for(int s = 0; s < kSectionCount; ++s) {
+    if(!HasSection(s, header.flags)) continue;
+    header.sections[s].offset = offset;
+    header.sections[s].bytes = bytes[s];
+    header.sections[s].checksum = SnapshotChecksum(data[s], bytes[s]);
+    offset = RoundUp(offset + bytes[s]);
+  }
+  header.header_checksum = SnapshotChecksum(
+    reinterpret_cast<const char*>(&header),
+    offsetof(SnapshotHeader, header_checksum));
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if(!out) return false;
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  uint64_t written = sizeof(header);
+  const char padding[kSnapshotAlignment] = {};
+  for(int s = 0; s < kSectionCount; ++s) {
+    if(header.sections[s].offset == 0) continue;
+    out.write(padding, header.sections[s].offset - written);
+    out.write(data[s], bytes[s]);
+    written = header.sections[s].offset + bytes[s];
+  }
+  out.close();
+  return !out.fail();
+}
+
+bool CsrGraph::OpenSnapshot(const std::string& path, bool verify,
+                            CsrGraph* graph) {
+  std::unique_ptr<MappedSnapshot> snapshot(new MappedSnapshot());
+  snapshot->file = MappedFile::Open(path);
+  if(snapshot->file == nullptr) return false;
+  const char* base = snapshot->file->data();
+  uint64_t file_size = snapshot->file->size();
+  // everything about the header is cheap to check, so always check it
+  if(file_size < sizeof(SnapshotHeader)) return false;
+  SnapshotHeader header;
+  std::memcpy(&header, base, sizeof(header));
+  if(std::memcmp(header.magic, kSnapshotMagic, sizeof(header.magic)) != 0 ||
+     header.version != kSnapshotVersion ||
+     header.byte_order != kSnapshotByteOrder ||
+     header.header_checksum != SnapshotChecksum(
+       base, offsetof(SnapshotHeader, header_checksum))) {
+    return false;
+  }
+  int64 count = header.node_count;
+  int64 edge_count = header.edge_count;
+  // dense indices are int32, and no section can be bigger than the file.
+  // Checked before any of the sizes below are multiplied out, so a
+  // crafted count can't wrap them around to something small.
+  if(count < 0 || edge_count < 0 ||
+     count > std::numeric_limits<int32>::max() ||
+     static_cast<uint64_t>(edge_count) > file_size / sizeof(int32) ||
+     static_cast<uint64_t>(count) + 1 > file_size / sizeof(int64)) {
+    return false;
+  }
+  bool has_incoming = header.flags & kSnapshotHasIncoming;
+  bool has_weights = header.flags & kSnapshotHasWeights;
+  uint64_t expected[kSectionCount] = {
+    count * sizeof(int64),
+    (count + 1) * sizeof(int64),
+    edge_count * sizeof(int32),
+    (count + 1) * sizeof(int64),
+    edge_count * sizeof(int32),
+    edge_count * sizeof(double),
+    edge_count * sizeof(double)};
+  uint64_t element[kSectionCount] = {
+    sizeof(int64), sizeof(int64), sizeof(int32), sizeof(int64),
+    sizeof(int32), sizeof(double), sizeof(double)};
+  for(int s = 0; s < kSectionCount; ++s) {
+    if(!HasSection(s, header.flags)) continue;
+    const SnapshotSection& section = header.sections[s];
+    if(!ValidSection(section, expected[s], element[s], file_size)) {
+      return false;
+    }
+    if(verify && section.checksum !=
+       SnapshotChecksum(base + section.offset, section.bytes)) {
+      return false;
+    }
+  }
+  auto ids = reinterpret_cast<const int64*>(
+    base + header.sections[kSectionIds].offset);
+  auto out_offsets = reinterpret_cast<const int64*>(
+    base + header.sections[kSectionOutOffsets].offset);
+  auto out_targets = reinterpret_cast<const int32*>(
+    base + header.sections[kSectionOutTargets].offset);
+  if(verify) {
+    for(int64 i = 1; i < count; ++i) {
+      if(ids[i] <= ids[i - 1]) return false;
+    }
+    if(!ValidEdges(count, edge_count, out_offsets, out_targets)) {
+      return false;
+    }
+  }
+  const double* out_weights = nullptr;
+  const double* in_weights = nullptr;
+  if(has_weights) {
+    out_weights = reinterpret_cast<const double*>(
+      base + header.sections[kSectionOutWeights].offset);
+    if(verify && !ValidWeights(edge_count, out_weights)) return false;
+  }
+  const int64* in_offsets;
+  const int32* in_targets;
+  if(has_incoming) {
+    in_offsets = reinterpret_cast<const int64*>(
+      base + header.sections[kSectionInOffsets].offset);
+    in_targets = reinterpret_cast<const int32*>(
+      base + header.sections[kSectionInTargets].offset);
+    if(verify && !ValidEdges(count, edge_count, in_offsets, in_targets)) {
+      return false;
+    }
+    if(has_weights) {
+      in_weights = reinterpret_cast<const double*>(
+        base + header.sections[kSectionInWeights].offset);
+      if(verify && !ValidWeights(edge_count, in_weights)) return false;
+    }
+  } else {
+    // not in the file, so this is the one thing we do have to build
+    Transpose(count, out_offsets, out_targets, out_weights,
+              &snapshot->in_offsets, &snapshot->in_targets,
+              &snapshot->in_weights);
+    in_offsets = snapshot->in_offsets.data();
+    in_targets = snapshot->in_targets.data();
+    if(has_weights) in_weights = snapshot->in_weights.data();
+  }
+  CsrGraph result;
+  result.count_ = count;
+  result.edge_count_ = edge_count;
+  result.ids_ = ids;
+  result.out_offsets_ = out_offsets;
+  result.out_targets_ = out_targets;
+  result.in_offsets_ = in_offsets;
+  result.in_targets_ = in_targets;
+  result.out_weights_ = out_weights;
+  result.in_weights_ = in_weights;
+  result.owner_ = std::shared_ptr<const MappedSnapshot>(std::move(snapshot));
+  *graph = result;
+  return true;
+}
@@ -0,0 +1,72 @@
+#ifndef CSR_SNAPSHOT_H_INCLUDE
+#define CSR_SNAPSHOT_H_INCLUDE
+#include<cstdint>
+
+// On-disk format of CsrGraph::WriteSnapshot / CsrGraph::OpenSnapshot.
+//
+// The file is laid out exactly like a CsrGraph in memory, so opening it is
+// just mapping it and pointing the arrays at the right offsets:
+//
+//   SnapshotHeader
+//   ids          int64[node_count]       sorted
+//   out_offsets  int64[node_count + 1]
+//   out_targets  int32[edge_count]       every row sorted
+//   in_offsets   int64[node_count + 1]   only with kSnapshotHasIncoming
+//   in_targets   int32[edge_count]       only with kSnapshotHasIncoming
+//   out_weights  double[edge_count]      only with kSnapshotHasWeights
+//   in_weights   double[edge_count]      only with both flags
+//
+// Every section starts at a multiple of kSnapshotAlignment bytes from the
+// start of the file and has its own checksum, so a reader can check just
+// the parts it uses. Integers are stored in the byte order of the machine
+// that wrote the file; byte_order lets a reader notice a mismatch and
+// refuse the file instead of reading garbage.
+//
+// Bump kSnapshotVersion on any change to this layout.
+
+const char kSnapshotMagic[8] = {'F', 'W', 'G', 'C', 'S', 'R', '\0', '\0'};
+const uint32_t kSnapshotVersion = 2;
+const uint64_t kSnapshotByteOrder = 0x0102030405060708ULL;
+const uint64_t kSnapshotAlignment = 64;
+
+// flags
+const uint32_t kSnapshotHasIncoming = 1;
+const uint32_t kSnapshotHasWeights = 2;
+
+enum SnapshotSectionId {
+  kSectionIds = 0,
+  kSectionOutOffsets,
+  kSectionOutTargets,
+  kSectionInOffsets,
+  kSectionInTargets,
+  kSectionOutWeights,
+  kSectionInWeights,
+  kSectionCount
+};
+
+struct SnapshotSection {
+  // where the section starts, from the beginning of the file
+  uint64_t offset;
+  uint64_t bytes;
+  // SnapshotChecksum of the section's bytes
+  uint64_t checksum;
+};
+
+struct SnapshotHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t flags;
+  uint64_t byte_order;
+  int64_t node_count;
+  int64_t edge_count;
+  // absent sections are all zeros
+  SnapshotSection sections[kSectionCount];
+  // SnapshotChecksum of all the header bytes before this field
+  uint64_t header_checksum;
+};
+
+// 64 bit FNV-1a, eight bytes at a time. Not cryptographic, just enough to
+// catch truncated copies and flipped bits.
+uint64_t SnapshotChecksum(const char* data, uint64_t bytes);
+
+#endif
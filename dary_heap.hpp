@@ -0,0 +1,68 @@
+#ifndef DARY_HEAP_H_INCLUDE
+#define DARY_HEAP_H_INCLUDE
+#include<vector>
+#include<functional>
+#include<utility>
+
+// A min-heap where every node has D children instead of 2. The tree is
+// D/2 times shallower, so a push does fewer moves, and the children of a
+// node sit next to each other in the array, so the scan for the smallest
+// one in a pop stays within a cache line or two. With D = 4 that beats
+// std::priority_queue for the push heavy workload of Dijkstra.
+//
+// Less says which element comes out first, like for std::sort (the
+// smallest does).
+template<typename T, int D = 4, typename Less = std::less<T>>
+class DaryHeap {
+ public:
+  bool empty() const { return items_.empty(); }
+  size_t size() const { return items_.size(); }
+
+  // The smallest element. The heap must not be empty.
+  const T& top() const { return items_.front(); }
+
+  void push(T item) {
+    size_t i = items_.size();
+    items_.push_back(std::move(item));
+    // move the hole up until the parent is no bigger than the new item
+    T moving = std::move(items_[i]);
+    while(i > 0) {
+      size_t parent = (i - 1) / D;
+      if(!less_(moving, items_[parent])) break;
+      items_[i] = std::move(items_[parent]);
+      i = parent;
+    }
+    items_[i] = std::move(moving);
+  }
+
+  // Removes the smallest element. The heap must not be empty.
+  void pop() {
+    T moving = std::move(items_.back());
+    items_.pop_back();
+    if(items_.empty()) return;
+    size_t size = items_.size();
+    size_t i = 0;
+    // move the hole at the root down to where the old last element fits
+    while(true) {
+      size_t first = i * D + 1;
+      if(first >= size) break;
+      size_t last = first + D < size ? first + D : size;
+      size_t smallest = first;
+      for(size_t c = first + 1; c < last; ++c) {
+        if(less_(items_[c], items_[smallest])) smallest = c;
+      }
+      if(!less_(items_[smallest], moving)) break;
+      items_[i] = std::move(items_[smallest]);
+      i = smallest;
+    }
+    items_[i] = std::move(moving);
+  }
+
+  void clear() { items_.clear(); }
+
+ private:
+  std::vector<T> items_;
+  Less less_;
+};
+
+#endif
@@ -0,0 +1,165 @@
+#include "distance_index.hpp"
+#include<vector>
+#include<algorithm>
+#include<utility>
+
+DistanceIndex::DistanceIndex() :
+  out_offsets_(1, 0), in_offsets_(1, 0) {}
+
+DistanceIndex DistanceIndex::Build(Graph* graph, ThreadPool* pool) {
+  return Build(graph->Freeze(), pool);
+}
+
+DistanceIndex DistanceIndex::Build(const CsrGraph& graph, ThreadPool* pool) {
+  DistanceIndex index;
+  int32 count = graph.Count();
+  index.ids_.resize(count);
+  for(int32 v = 0; v < count; ++v) index.ids_[v] = graph.IdOf(v);
+  // hubs in order of degree, the nodes most shortest paths go through
+  // first
+  std::vector<int32> order(count);
+  for(int32 v = 0; v < count; ++v) order[v] = v;
+  std::stable_sort(order.begin(), order.end(), [&](int32 a, int32 b) {
+    return graph.OutDegree(a) + graph.InDegree(a) >
+      graph.OutDegree(b) + graph.InDegree(b);
+  });
+  // labels while building, one growable vector per node. Hubs are added
+  // in rank order, so every label stays sorted by hub.
+  std::vector<std::vector<Entry>> out_labels(count);
+  std::vector<std::vector<Entry>> in_labels(count);
+  CsrGraph reversed = graph.Reversed();
+
+  int threads = pool == nullptr ? 1 : pool->size();
+  // per thread scratch: BFS distances by node and the hub's own label
+  // spread out by rank, both all -1 between searches
+  std::vector<std::vector<int32>> distance(threads,
+                                           std::vector<int32>(count, -1));
+  std::vector<std::vector<int32>> hub_label(threads,
+                                            std::vector<int32>(count, -1));
+  // (node, distance) pairs found by each search of the current round,
+  // forward and backward
+  std::vector<std::vector<std::pair<int32, int32>>> found(threads * 2);
+
+  // One pruned BFS from the hub of rank r. Forward, it walks outgoing
+  // edges and finds in label entries (the hub reaches v); backward it
+  // walks incoming edges and finds out label entries.
+  auto search = [&](int thread, int32 r, bool forward,
+                    std::vector<std::pair<int32, int32>>* hits) {
+    const CsrGraph& walk = forward ? graph : reversed;
+    int32 hub = order[r];
+    // forward, a node's distance from the hub is known through hubs that
+    // are in the hub's out label and the node's in label
+    const std::vector<Entry>& own = forward ? out_labels[hub] : in_labels[hub];
+    const std::vector<std::vector<Entry>>& other =
+      forward ? in_labels : out_labels;
+    std::vector<int32>& dist = distance[thread];
+    std::vector<int32>& spread = hub_label[thread];
+    for(const Entry& entry : own) spread[entry.hub] = entry.distance;
+    std::vector<int32> queue(1, hub);
+    dist[hub] = 0;
+    for(size_t head = 0; head < queue.size(); ++head) {
+      int32 v = queue[head];
+      int32 d = dist[v];
+      bool covered = false;
+      for(const Entry& entry : other[v]) {
+        if(spread[entry.hub] != -1 &&
+           spread[entry.hub] + entry.distance <= d) {
+          covered = true;
+          break;
+        }
+      }
+      if(covered) continue;
+      hits->push_back(std::make_pair(v, d));
+      for(int32 w : walk.OutNeighbors(v)) {
+        if(dist[w] != -1) continue;
+        dist[w] = d + 1;
+        queue.push_back(w);
+      }
+    }
+    for(int32 v : queue) dist[v] = -1;
+    for(const Entry& entry : own) spread[entry.hub] = -1;
+  };
+
+  for(int32 first = 0; first < count; first += threads) {
+    int32 last = std::min<int64>(first + threads, count);
+    auto run = [&](int thread, int64 begin, int64 end) {
+      for(int64 i = begin; i < end; ++i) {
+        int32 r = first + i / 2;
+        std::vector<std::pair<int32, int32>>& hits = found[i];
+        hits.clear();
+        search(thread, r, i % 2 == 0, &hits);
+      }
+    };
+    // every search of the round only reads labels, they are all added at
+    // the end of it, in rank order
+    ParallelFor(pool, (last - first) * 2, 1, run);
+    for(int32 r = first; r < last; ++r) {
+      for(const std::pair<int32, int32>& hit : found[(r - first) * 2]) {
+        in_labels[hit.first].push_back(Entry{r, hit.second});
+      }
+      for(const std::pair<int32, int32>& hit : found[(r - first) * 2 + 1]) {
+        out_labels[hit.first].push_back(Entry{r, hit.second});
+      }
+    }
+  }
+
+  // pack the labels into flat arrays
+  auto pack = [count](std::vector<std::vector<Entry>>* labels,
+                      std::vector<int64>* offsets,
+                      std::vector<Entry>* entries) {
+    offsets->assign(count + 1, 0);
+    for(int32 v = 0; v < count; ++v) {
+      (*offsets)[v + 1] = (*offsets)[v] + (*labels)[v].size();
+    }
+    entries->reserve((*offsets)[count]);
+    for(std::vector<Entry>& label : *labels) {
+      entries->insert(entries->end(), label.begin(), label.end());
+      std::vector<Entry>().swap(label);
+    }
+  };
+  pack(&out_labels, &index.out_offsets_, &index.out_entries_);
+  pack(&in_labels, &index.in_offsets_, &index.in_entries_);
+  return index;
+}
+
+int32 DistanceIndex::Distance(int64 from, int64 to) const {
+  auto a = std::lower_bound(ids_.begin(), ids_.end(), from);
+  auto b = std::lower_bound(ids_.begin(), ids_.end(), to);
+  if(a == ids_.end() || *a != from || b == ids_.end() || *b != to) return -1;
+  const Entry* out = out_entries_.data() + out_offsets_[a - ids_.begin()];
+  const Entry* out_end = out_entries_.data() + out_offsets_[a - ids_.begin() + 1];
+  const Entry* in = in_entries_.data() + in_offsets_[b - ids_.begin()];
+  const Entry* in_end = in_entries_.data() + in_offsets_[b - ids_.begin() + 1];
+  // both labels are sorted by hub, walk them side by side
+  int32 best = -1;
+  while(out != out_end && in != in_end) {
+    if(out->hub < in->hub) {
+      ++out;
+    } else if(in->hub < out->hub) {
+      ++in;
+    } else {
+      int32 through = out->distance + in->distance;
+      if(best == -1 || through < best) best = through;
+      ++out;
+      ++in;
+    }
+  }
+  return best;
+}
+
+std::vector<int64> DistanceIndex::ShortestPath(Graph* graph, int64 from,
+                                               int64 to) const {
+  if(Distance(from, to) == -1) return std::vector<int64>();
+  return graph->ShortestPath(from, to);
+}
+
+int64 DistanceIndex::LabelSize() const {
+  return out_entries_.size() + in_entries_.size();
+}
+
+int64 DistanceIndex::MemoryBytes() const {
+  return sizeof(*this) +
+    ids_.capacity() * sizeof(int64) +
+    (out_offsets_.capacity() + in_offsets_.capacity()) * sizeof(int64) +
+    (out_entries_.capacity() + in_entries_.capacity()) * sizeof(Entry);
+}
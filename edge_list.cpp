@@ -0,0 +1,140 @@
+#include "edge_list.hpp"
+#include "mapped_file.hpp"
+#include<vector>
+#include<string>
+#include<memory>
+#include<algorithm>
+
+namespace {
+
+enum Scan { kEnd, kNumber, kMalformed };
+
+// Scans the next integer in [*cursor, end), skipping anything before it
+// that can't start a number. Returns kEnd if there is none left, and
+// kMalformed for a '-' without digits after it or a number that doesn't
+// fit in an int64. -9223372036854775808 does fit.
+Scan NextInteger(const char** cursor, const char* end, int64* value) {
+  const char* p = *cursor;
+  while(p < end && !(*p >= '0' && *p <= '9') && *p != '-') ++p;
+  if(p == end) return kEnd;
+  bool negative = false;
+  if(*p == '-') {
+    negative = true;
+    ++p;
+  }
+  if(p == end || !(*p >= '0' && *p <= '9')) return kMalformed;
+  // accumulate unsigned, the most negative int64 has no positive twin
+  const unsigned long long limit = negative ? 9223372036854775808ULL :
+    9223372036854775807ULL;
+  unsigned long long magnitude = 0;
+  while(p < end && *p >= '0' && *p <= '9') {
+    unsigned digit = *p - '0';
+    if(magnitude > (limit - digit) / 10) return kMalformed;
+    magnitude = magnitude * 10 + digit;
+    ++p;
+  }
+  // negated in unsigned arithmetic, which wraps instead of overflowing
+  *value = negative ? static_cast<int64>(0ULL - magnitude) :
+    static_cast<int64>(magnitude);
+  *cursor = p;
+  return kNumber;
+}
+
+// Moves position forward to just past the next newline (or to end), so
+// that chunks always start at the beginning of a line.
+const char* NextLine(const char* position, const char* begin,
+                     const char* end) {
+  if(position == begin) return position;
+  const char* newline = std::find(position - 1, end, '\n');
+  return newline == end ? end : newline + 1;
+}
+
+}  // namespace
+
+bool ReadEdgeList(const std::string& path, ThreadPool* pool,
+                  std::vector<std::pair<int64, int64>>* edges) {
+  edges->clear();
+  std::unique_ptr<MappedFile> file = MappedFile::Open(path);
+  if(file == nullptr) return false;
+  file->AdviseSequential();
+  const char* cursor = file->data();
+  const char* end = cursor + file->size();
+  int64 expected;
+  Scan header = NextInteger(&cursor, end, &expected);
+  if(header == kEnd) return true;
+  if(header == kMalformed) return false;
+  const char* body = NextLine(cursor, file->data(), end);
+  // a few chunks per thread, so a thread that gets a slow chunk doesn't
+  // hold everybody up
+  int threads = pool == nullptr ? 1 : pool->size();
+  int64 length = end - body;
+  int64 chunks = std::max<int64>(1, std::min<int64>(threads * 4,
+                                                    length >> 16));
+  int64 chunk_size = length / chunks + 1;
+  std::vector<std::vector<std::pair<int64, int64>>> parsed(chunks);
+  // one flag per chunk, so threads don't share one
+  std::vector<char> malformed(chunks, 0);
+  auto parse = [&](int thread, int64 first, int64 last) {
+    for(int64 chunk = first; chunk < last; ++chunk) {
+      // both ends get pushed to line starts, so every line ends up in
+      // exactly one chunk
+      const char* from = NextLine(
+        body + std::min(chunk * chunk_size, length), body, end);
+      const char* to = NextLine(
+        body + std::min((chunk + 1) * chunk_size, length), body, end);
+      std::vector<std::pair<int64, int64>>& out = parsed[chunk];
+      out.reserve((to - from) / 4);
+      int64 source, target, extra;
+      while(from < to) {
+        // a line is blank or holds exactly one edge. A lone number or a
+        // third one means the file isn't what we think it is.
+        const char* line_end = std::find(from, to, '\n');
+        Scan first = NextInteger(&from, line_end, &source);
+        if(first != kEnd) {
+          Scan second = first == kNumber ?
+            NextInteger(&from, line_end, &target) : first;
+          Scan third = second == kNumber ?
+            NextInteger(&from, line_end, &extra) : kMalformed;
+          if(third != kEnd) {
+            malformed[chunk] = 1;
+            break;
+          }
+          out.push_back(std::make_pair(source, target));
+        }
+        from = line_end == to ? to : line_end + 1;
+      }
+    }
+  };
+  ParallelFor(pool, chunks, 1, parse);
+  for(char bad : malformed) {
+    if(bad) return false;
+  }
+  int64 total = 0;
+  for(auto& chunk : parsed) total += chunk.size();
+  edges->reserve(std::min(total, std::max<int64>(expected, 0)));
+  for(auto& chunk : parsed) {
+    for(auto& edge : chunk) {
+      if(static_cast<int64>(edges->size()) == expected) return true;
+      edges->push_back(edge);
+    }
+    // give the memory back as we go, the chunks can be big
+    std::vector<std::pair<int64, int64>>().swap(chunk);
+  }
+  return true;
+}
+
+std::unique_ptr<Graph> LoadGraph(const std::string& path, ThreadPool* pool) {
+  std::vector<std::pair<int64, int64>> edges;
+  if(!ReadEdgeList(path, pool, &edges)) return nullptr;
+  std::unique_ptr<Graph> result = std::unique_ptr<Graph>(new Graph());
+  result->AddAndConnectBatch(edges, pool);
+  return result;
+}
+
+bool LoadCsrGraph(const std::string& path, ThreadPool* pool,
+                  CsrGraph* graph) {
+  std::vector<std::pair<int64, int64>> edges;
+  if(!ReadEdgeList(path, pool, &edges)) return false;
+  *graph = CsrGraph::FromEdges(edges);
+  return true;
+}
@@ -0,0 +1,37 @@
+#ifndef EDGE_LIST_H_INCLUDE
+#define EDGE_LIST_H_INCLUDE
+#include<vector>
+#include<string>
+#include<memory>
+#include<utility>
+#include "graph.hpp"
+#include "csr_graph.hpp"
+#include "thread_pool.hpp"
+
+// Loading graphs from text edge lists, like test1.txt: the number of edges
+// m first, then m lines of "from to". Ids may be negative.
+//
+// The file is mapped into memory and cut into chunks at line boundaries,
+// and each chunk is parsed by a thread of the pool with a hand rolled
+// integer scanner (no streams, no locale, no copies). pool may be nullptr
+// to parse on the calling thread only.
+
+// Reads the edges of the file at path into edges, in file order. If the
+// file has more than m edges only the first m are kept. Returns false if
+// the file can't be read, has a line with other than two numbers on it
+// (blank lines are fine), or has a number that doesn't fit in an int64
+// or a '-' without digits after it.
+bool ReadEdgeList(const std::string& path, ThreadPool* pool,
+                  std::vector<std::pair<int64, int64>>* edges);
+
+// Reads the file at path into a new Graph. Returns nullptr if
+// ReadEdgeList fails.
+std::unique_ptr<Graph> LoadGraph(const std::string& path, ThreadPool* pool);
+
+// Reads the file at path straight into a CsrGraph, skipping Graph
+// altogether. This is the fast way to get a read-only graph up. Returns
+// false if ReadEdgeList fails.
+bool LoadCsrGraph(const std::string& path, ThreadPool* pool,
+                  CsrGraph* graph);
+
+#endif
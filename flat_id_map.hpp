@@ -0,0 +1,220 @@
+#ifndef FLAT_ID_MAP_H_INCLUDE
+#define FLAT_ID_MAP_H_INCLUDE
+#include<vector>
+#include<utility>
+#include<algorithm>
+#include<stdexcept>
+#include<cstdint>
+
+typedef long long int64;
+
+// A hash map from int64 ids to values, made for node lookup. It is a
+// single flat array of (key, value) slots with linear probing, so a lookup
+// is one hash and (almost always) one cache line, and there are no per
+// entry heap allocations like in std::map or std::unordered_map.
+//
+// Iteration goes over the slots in table order, NOT in key order. If you
+// need the keys sorted, ask for SortedKeys().
+template<typename V>
+class FlatIdMap {
+ public:
+  typedef std::pair<int64, V> value_type;
+
+  // Walks the occupied slots. Do not change the key through this!
+  template<typename MapType, typename Value>
+  class Iterator {
+   public:
+    Iterator(MapType* map, size_t slot) : map_(map), slot_(slot) {
+      SkipEmpty();
+    }
+    Value& operator*() const { return map_->slots_[slot_]; }
+    Value* operator->() const { return &map_->slots_[slot_]; }
+    Iterator& operator++() {
+      ++slot_;
+      SkipEmpty();
+      return *this;
+    }
+    bool operator==(const Iterator& other) const {
+      return slot_ == other.slot_;
+    }
+    bool operator!=(const Iterator& other) const {
+      return slot_ != other.slot_;
+    }
+   private:
+    void SkipEmpty() {
+      while(slot_ < map_->used_.size() && !map_->used_[slot_]) ++slot_;
+    }
+    MapType* map_;
+    size_t slot_;
+  };
+  typedef Iterator<FlatIdMap, value_type> iterator;
+  typedef Iterator<const FlatIdMap, const value_type> const_iterator;
+
+  FlatIdMap() : mask_(0), size_(0) {}
+
+  int64 size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  iterator begin() { return iterator(this, 0); }
+  iterator end() { return iterator(this, used_.size()); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, used_.size()); }
+
+  // Returns a pointer to the value stored under key, or nullptr.
+  V* Find(int64 key) {
+    size_t slot = FindSlot(key);
+    return slot == kNotFound ? nullptr : &slots_[slot].second;
+  }
+  const V* Find(int64 key) const {
+    size_t slot = FindSlot(key);
+    return slot == kNotFound ? nullptr : &slots_[slot].second;
+  }
+
+  bool Contains(int64 key) const {
+    return FindSlot(key) != kNotFound;
+  }
+
+  // Same as std::map::at, throws std::out_of_range on a missing key.
+  V& at(int64 key) {
+    V* value = Find(key);
+    if(value == nullptr) throw std::out_of_range("FlatIdMap::at");
+    return *value;
+  }
+  const V& at(int64 key) const {
+    const V* value = Find(key);
+    if(value == nullptr) throw std::out_of_range("FlatIdMap::at");
+    return *value;
+  }
+
+  // Inserts the value under key. Like std::map::insert, does nothing and
+  // returns false if the key is already there.
+  bool Insert(int64 key, V value) {
+    if(Contains(key)) return false;
+    GrowIfNeeded();
+    size_t slot = Home(key);
+    while(used_[slot]) slot = (slot + 1) & mask_;
+    used_[slot] = 1;
+    slots_[slot].first = key;
+    slots_[slot].second = std::move(value);
+    ++size_;
+    return true;
+  }
+
+  // Returns the value under key, inserting a default constructed one first
+  // if it is not there yet.
+  V& operator[](int64 key) {
+    V* value = Find(key);
+    if(value != nullptr) return *value;
+    Insert(key, V());
+    return at(key);
+  }
+
+  // Removes the key. Returns false if it was not there.
+  bool Erase(int64 key) {
+    size_t hole = FindSlot(key);
+    if(hole == kNotFound) return false;
+    // Backward shift deletion: instead of leaving a tombstone we pull
+    // later entries of the same probe run back into the hole, so lookups
+    // never get slower after a lot of deletes.
+    size_t next = (hole + 1) & mask_;
+    while(used_[next]) {
+      size_t home = Home(slots_[next].first);
+      // the entry at next may move into the hole only if its home is not
+      // cyclically inside (hole, next]
+      if(((next - home) & mask_) >= ((next - hole) & mask_)) {
+        slots_[hole] = std::move(slots_[next]);
+        hole = next;
+      }
+      next = (next + 1) & mask_;
+    }
+    used_[hole] = 0;
+    slots_[hole] = value_type();
+    --size_;
+    return true;
+  }
+
+  // Makes room for n keys without rehashing.
+  void Reserve(int64 n) {
+    size_t capacity = 16;
+    while(static_cast<int64>(capacity) * kMaxLoadNum < n * kMaxLoadDen) {
+      capacity *= 2;
+    }
+    if(capacity > used_.size()) Rehash(capacity);
+  }
+
+  void Clear() {
+    slots_.clear();
+    used_.clear();
+    size_ = 0;
+  }
+
+  // The keys in increasing order, for when iteration order matters.
+  std::vector<int64> SortedKeys() const {
+    std::vector<int64> keys;
+    keys.reserve(size_);
+    for(size_t i = 0; i < used_.size(); ++i) {
+      if(used_[i]) keys.push_back(slots_[i].first);
+    }
+    std::sort(keys.begin(), keys.end());
+    return keys;
+  }
+
+ private:
+  static const size_t kNotFound = static_cast<size_t>(-1);
+  // grow when the table is more than 3/4 full
+  static const int64 kMaxLoadNum = 3;
+  static const int64 kMaxLoadDen = 4;
+
+  size_t Home(int64 key) const {
+    // ids are usually small consecutive numbers, so they need a good mix
+    // before we take the low bits (this is the splitmix64 finalizer)
+    uint64_t h = static_cast<uint64_t>(key);
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    h = h ^ (h >> 31);
+    return h & mask_;
+  }
+
+  size_t FindSlot(int64 key) const {
+    if(size_ == 0) return kNotFound;
+    size_t slot = Home(key);
+    while(used_[slot]) {
+      if(slots_[slot].first == key) return slot;
+      slot = (slot + 1) & mask_;
+    }
+    return kNotFound;
+  }
+
+  void GrowIfNeeded() {
+    if(used_.empty()) {
+      Rehash(16);
+    } else if((size_ + 1) * kMaxLoadDen >
+              static_cast<int64>(used_.size()) * kMaxLoadNum) {
+      Rehash(used_.size() * 2);
+    }
+  }
+
+  void Rehash(size_t capacity) {
+    std::vector<value_type> old_slots(capacity);
+    std::vector<unsigned char> old_used(capacity, 0);
+    old_slots.swap(slots_);
+    old_used.swap(used_);
+    mask_ = capacity - 1;
+    for(size_t i = 0; i < old_used.size(); ++i) {
+      if(!old_used[i]) continue;
+      size_t slot = Home(old_slots[i].first);
+      while(used_[slot]) slot = (slot + 1) & mask_;
+      used_[slot] = 1;
+      slots_[slot] = std::move(old_slots[i]);
+    }
+  }
+
+  std::vector<value_type> slots_;
+  // used_[i] says whether slots_[i] holds an entry. Kept apart from the
+  // slots so any int64 (including -1) can be a key.
+  std::vector<unsigned char> used_;
+  size_t mask_;
+  int64 size_;
+};
+
+#endif
@@ -0,0 +1,199 @@
+#include "generators.hpp"
+#include<vector>
+#include<utility>
+#include<algorithm>
+#include<cmath>
+#include<cstdint>
+
+namespace {
+
+// edges (or expected edges) per chunk, every chunk gets its own generator
+const int64 kChunk = 1 << 16;
+
+// splitmix64: advances state and returns the next 64 random bits. Good
+// enough statistically for this, and any seed, 0 included, is fine.
+uint64_t SplitMix(uint64_t* state) {
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+// A generator state for chunk (or edge) number index of a run seeded with
+// seed. Nearby seeds and indexes give unrelated states.
+uint64_t Derive(uint64_t seed, uint64_t index) {
+  uint64_t state = seed;
+  uint64_t mixed = SplitMix(&state) ^ index;
+  return SplitMix(&mixed);
+}
+
+// Uniform in [0, 1), from the top 53 bits.
+double Uniform(uint64_t* state) {
+  return (SplitMix(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Glues the chunks' edges together in chunk order.
+std::vector<std::pair<int64, int64>> Concatenate(
+  std::vector<std::vector<std::pair<int64, int64>>>* chunks) {
+  size_t total = 0;
+  for(const auto& chunk : *chunks) total += chunk.size();
+  std::vector<std::pair<int64, int64>> result;
+  result.reserve(total);
+  for(auto& chunk : *chunks) {
+    result.insert(result.end(), chunk.begin(), chunk.end());
+    std::vector<std::pair<int64, int64>>().swap(chunk);
+  }
+  return result;
+}
+
+// The edge with position index among the n * (n - 1) possible ones, in
+// (from, to) order with self loops left out.
+std::pair<int64, int64> EdgeAt(int64 n, int64 index) {
+  int64 from = index / (n - 1);
+  int64 to = index % (n - 1);
+  return std::make_pair(from, to < from ? to : to + 1);
+}
+
+}  // namespace
+
+std::vector<std::pair<int64, int64>> RMatEdges(int scale, int64 edges,
+                                               double a, double b, double c,
+                                               uint64_t seed,
+                                               ThreadPool* pool) {
+  std::vector<std::pair<int64, int64>> result(edges);
+  int64 chunks = (edges + kChunk - 1) / kChunk;
+  ParallelFor(pool, chunks, 1, [&](int thread, int64 begin, int64 end) {
+    for(int64 chunk = begin; chunk < end; ++chunk) {
+      uint64_t state = Derive(seed, chunk);
+      int64 last = std::min(edges, (chunk + 1) * kChunk);
+      for(int64 e = chunk * kChunk; e < last; ++e) {
+        int64 from = 0;
+        int64 to = 0;
+        for(int bit = scale - 1; bit >= 0; --bit) {
+          double r = Uniform(&state);
+          if(r < a) continue;
+          if(r < a + b) {
+            to |= int64(1) << bit;
+          } else if(r < a + b + c) {
+            from |= int64(1) << bit;
+          } else {
+            from |= int64(1) << bit;
+            to |= int64(1) << bit;
+          }
+        }
+        result[e] = std::make_pair(from, to);
+      }
+    }
+  });
+  return result;
+}
+
+std::vector<std::pair<int64, int64>> ErdosRenyiEdges(int64 n, double p,
+                                                     uint64_t seed,
+                                                     ThreadPool* pool) {
+  if(n < 2 || p <= 0) return std::vector<std::pair<int64, int64>>();
+  // whole rows per chunk, about kChunk edges each
+  int64 rows = std::max<int64>(
+    1, std::min<double>(n, kChunk / (p * (n - 1))));
+  int64 chunks = (n + rows - 1) / rows;
+  std::vector<std::vector<std::pair<int64, int64>>> found(chunks);
+  double log_miss = std::log(1 - p);
+  ParallelFor(pool, chunks, 1, [&](int thread, int64 begin, int64 end) {
+    for(int64 chunk = begin; chunk < end; ++chunk) {
+      uint64_t state = Derive(seed, chunk);
+      int64 first = chunk * rows * (n - 1);
+      int64 last = std::min(n, (chunk + 1) * rows) * (n - 1);
+      // the number of possible edges skipped before the next one is
+      // geometric, log(1 - U) / log(1 - p) rounded down. With p = 1 it
+      // is always 0.
+      for(int64 e = first - 1; ; ) {
+        double skip = p >= 1 ? 0 :
+          std::floor(std::log(1 - Uniform(&state)) / log_miss);
+        if(skip >= last - e - 1) break;
+        e += 1 + static_cast<int64>(skip);
+        found[chunk].push_back(EdgeAt(n, e));
+      }
+    }
+  });
+  return Concatenate(&found);
+}
+
+std::vector<std::pair<int64, int64>> RandomEdges(int64 n, int64 m,
+                                                 uint64_t seed,
+                                                 ThreadPool* pool) {
+  if(n < 2 || m <= 0) return std::vector<std::pair<int64, int64>>();
+  int64 possible = n * (n - 1);
+  // past half, drawing the edges to leave out is the cheaper side
+  bool leave_out = m > possible / 2;
+  int64 wanted = leave_out ? possible - m : m;
+  std::vector<int64> chosen;
+  chosen.reserve(wanted);
+  for(uint64_t round = 0; static_cast<int64>(chosen.size()) < wanted;
+      ++round) {
+    // draw one edge per edge still missing; repeats are squeezed out
+    // below and drawn again next round
+    int64 missing = wanted - chosen.size();
+    int64 start = chosen.size();
+    chosen.resize(wanted);
+    int64 chunks = (missing + kChunk - 1) / kChunk;
+    uint64_t round_seed = Derive(seed, round);
+    ParallelFor(pool, chunks, 1, [&](int thread, int64 begin, int64 end) {
+      for(int64 chunk = begin; chunk < end; ++chunk) {
+        uint64_t state = Derive(round_seed, chunk);
+        int64 last = std::min(missing, (chunk + 1) * kChunk);
+        for(int64 i = chunk * kChunk; i < last; ++i) {
+          chosen[start + i] = SplitMix(&state) % possible;
+        }
+      }
+    });
+    std::sort(chosen.begin(), chosen.end());
+    chosen.erase(std::unique(chosen.begin(), chosen.end()), chosen.end());
+  }
+  std::vector<std::pair<int64, int64>> result(m);
+  if(leave_out) {
+    int64 next = 0;
+    auto skipped = chosen.begin();
+    for(int64 e = 0; e < possible; ++e) {
+      if(skipped != chosen.end() && *skipped == e) {
+        ++skipped;
+      } else {
+        result[next++] = EdgeAt(n, e);
+      }
+    }
+  } else {
+    ParallelFor(pool, (m + kChunk - 1) / kChunk, 1,
+                [&](int thread, int64 begin, int64 end) {
+      for(int64 i = begin * kChunk; i < std::min(m, end * kChunk); ++i) {
+        result[i] = EdgeAt(n, chosen[i]);
+      }
+    });
+  }
+  return result;
+}
+
+std::vector<std::pair<int64, int64>> BarabasiAlbertEdges(int64 n, int k,
+                                                         uint64_t seed,
+                                                         ThreadPool* pool) {
+  int64 edges = n * k;
+  std::vector<std::pair<int64, int64>> result(edges);
+  // edge e goes from node e / k. Its target is an endpoint of an earlier
+  // edge, picked uniformly among the 2e of them: even ones are sources,
+  // odd ones are the targets of other edges, followed back the same way.
+  // The first edge has nothing to pick from and loops on node 0.
+  auto target = [&](int64 e) {
+    while(e != 0) {
+      uint64_t state = Derive(seed, e);
+      uint64_t pick = SplitMix(&state) % (2 * static_cast<uint64_t>(e));
+      if(pick % 2 == 0) return static_cast<int64>(pick / 2 / k);
+      e = pick / 2;
+    }
+    return int64(0);
+  };
+  ParallelFor(pool, (edges + kChunk - 1) / kChunk, 1,
+              [&](int thread, int64 begin, int64 end) {
+    for(int64 e = begin * kChunk; e < std::min(edges, end * kChunk); ++e) {
+      result[e] = std::make_pair(e / k, target(e));
+    }
+  });
+  return result;
+}
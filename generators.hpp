@@ -0,0 +1,67 @@
+#ifndef GENERATORS_H_INCLUDE
+#define GENERATORS_H_INCLUDE
+#include<vector>
+#include<utility>
+#include<cstdint>
+#include "thread_pool.hpp"
+
+// Random graphs for tests and benchmarks, as lists of (from, to) edges
+// over the ids 0..n-1, ready for Graph::AddAndConnectBatch or
+// CsrGraph::FromEdges (nodes that got no edge only survive the latter if
+// they are passed in its nodes argument too).
+//
+// All of them are deterministic: the work is cut into chunks of a fixed
+// size, and every chunk draws from its own generator seeded from seed and
+// the chunk's number (with splitmix64), so the same seed gives the same
+// edges in the same order whatever the pool, including none at all. The
+// chunks run in parallel on the pool, which may be nullptr.
+
+// R-MAT (Chakrabarti, Zhan and Faloutsos), the generator behind the
+// Graph500 Kronecker graphs: 2^scale nodes and exactly edges edges. Each
+// edge picks one quadrant of the adjacency matrix with probabilities a,
+// b, c and 1 - a - b - c, then a quadrant of that, scale times over,
+// which gives the skewed degrees and community structure of real
+// networks. a = 0.57, b = c = 0.19 is the Graph500 setting. Low ids get
+// the high degrees. Self loops and repeated edges are kept.
+std::vector<std::pair<int64, int64>> RMatEdges(int scale, int64 edges,
+                                               double a, double b, double c,
+                                               uint64_t seed,
+                                               ThreadPool* pool);
+
+// Erdos-Renyi G(n, p): every one of the n * (n - 1) possible edges (no
+// self loops) is there with probability p, independently. Instead of a
+// coin per possible edge, the gap to the next edge is drawn from its
+// geometric distribution (Batagelj and Brandes), so the cost is the
+// number of edges, not n^2. Edges come out sorted.
+std::vector<std::pair<int64, int64>> ErdosRenyiEdges(int64 n, double p,
+                                                     uint64_t seed,
+                                                     ThreadPool* pool);
+
+// G(n, m): exactly m distinct edges, all m-subsets of the n * (n - 1)
+// possible ones equally likely. Draws with repetition in parallel and
+// redraws what the repeats cost until there are m; past half of the
+// possible edges it picks the ones to leave out instead. m must not be
+// more than n * (n - 1). Edges come out sorted.
+std::vector<std::pair<int64, int64>> RandomEdges(int64 n, int64 m,
+                                                 uint64_t seed,
+                                                 ThreadPool* pool);
+
+// Barabasi-Albert preferential attachment: nodes arrive one at a time
+// and each links to k earlier nodes with probability proportional to
+// their degree, which gives a power law degree distribution. Returns
+// exactly n * k edges, from every node to its picks.
+//
+// Attaching one node after the other looks inherently serial, but it
+// isn't (Sanders and Schulz): picking by degree is picking an endpoint of
+// an earlier edge uniformly at random. If the endpoint is the source of
+// that edge, it is known right away; if it is the target, that target
+// was picked the same way, and the chain is followed back until it ends
+// at a source, which takes two steps on average. Since every edge's draws
+// come from a hash of the seed and the edge's position, any edge can be
+// worked out without the others, in any order. Repeated edges and a few
+// self loops are kept, as in the original model.
+std::vector<std::pair<int64, int64>> BarabasiAlbertEdges(int64 n, int k,
+                                                         uint64_t seed,
+                                                         ThreadPool* pool);
+
+#endif
@@ -1,49 +1,115 @@
 #include "graph.hpp"
+#include "csr_graph.hpp"
+#include "bidirectional_search.hpp"
+#include "thread_pool.hpp"
+#include "dary_heap.hpp"
 #include<vector>
 #include<iostream>
-#include<queue>
+#include<limits>
+#include<algorithm>
+#include<functional>
 
-void Graph::Node::InsertIncoming(int64 from) {
-  incoming_->insert(from);
+namespace {
+
+typedef std::pair<int64, int64> Edge;
+
+// Which shard of a batch an id goes to. Ids are mixed first so that runs
+// of consecutive ids get spread out.
+int64 ShardOf(int64 id, int64 shards) {
+  uint64_t h = static_cast<uint64_t>(id) * 0x9e3779b97f4a7c15ULL;
+  return (h >> 32) % shards;
+}
+
+// Splits edges into shards by their first element (so each node's edges
+// all land in the same shard) and sorts every shard. Shard s ends up in
+// (*sharded)[(*starts)[s] .. (*starts)[s + 1]).
+void ShardAndSort(const std::vector<Edge>& edges, int64 shards,
+                  ThreadPool* pool, std::vector<Edge>* sharded,
+                  std::vector<int64>* starts) {
+  // plain counting sort on the shard number: count, prefix sum, scatter
+  starts->assign(shards + 1, 0);
+  for(const Edge& edge : edges) ++(*starts)[ShardOf(edge.first, shards) + 1];
+  for(int64 s = 0; s < shards; ++s) (*starts)[s + 1] += (*starts)[s];
+  sharded->resize(edges.size());
+  std::vector<int64> fill(starts->begin(), starts->end() - 1);
+  for(const Edge& edge : edges) {
+    (*sharded)[fill[ShardOf(edge.first, shards)]++] = edge;
+  }
+  auto sort_shards = [&](int thread, int64 begin, int64 end) {
+    for(int64 s = begin; s < end; ++s) {
+      std::sort(sharded->begin() + (*starts)[s],
+                sharded->begin() + (*starts)[s + 1]);
+    }
+  };
+  ParallelFor(pool, shards, 1, sort_shards);
 }
 
-void Graph::Node::InsertOutgoing(int64 to) {
-  outgoing_->insert(to);
+}  // namespace
+
+Graph::Graph() :
+  hash_threshold_(Adjacency::kDefaultHashThreshold), stale_(0) {}
+
+Graph::Graph(int64 hash_threshold) :
+  hash_threshold_(hash_threshold), stale_(0) {}
+
+void Graph::Node::InsertIncoming(int64 from, int64 hash_threshold) {
+  incoming_.Insert(from, hash_threshold);
+}
+
+void Graph::Node::InsertOutgoing(int64 to, int64 hash_threshold) {
+  outgoing_.Insert(to, hash_threshold);
 }
 
 void Graph::Node::EraseIncoming(int64 from) {
-  incoming_->erase(from);
+  incoming_.Erase(from);
 }
 
 void Graph::Node::EraseOutgoing(int64 to) {
-  outgoing_->erase(to);
+  // a weight left behind would come back if the edge were made again
+  if(outgoing_.Erase(to) && weights_ != nullptr) weights_->Erase(to);
+}
+
+void Graph::Node::SetWeight(int64 to, double weight) {
+  if(weight == 1.0) {
+    // the default, nothing to remember
+    if(weights_ != nullptr) weights_->Erase(to);
+    return;
+  }
+  if(weights_ == nullptr) {
+    weights_ = std::unique_ptr<FlatIdMap<double>>(new FlatIdMap<double>());
+  }
+  (*weights_)[to] = weight;
+}
+
+double Graph::Node::WeightTo(int64 to) {
+  if(!outgoing_.Contains(to)) return std::numeric_limits<double>::infinity();
+  const double* weight = weights_ == nullptr ? nullptr : weights_->Find(to);
+  return weight == nullptr ? 1.0 : *weight;
 }
 
 bool Graph::Node::ContainsEdgeTo(int64 to) {
-  // apparently the standard c++ way to check if something is in range
   // call this too many times to not make this a method...
-  return outgoing_->find(to) != outgoing_->end();
+  return outgoing_.Contains(to);
 }
 
 bool Graph::Node::ContainsEdgeFrom(int64 from) {
-  return incoming_->find(from) != incoming_->end();
+  return incoming_.Contains(from);
 }
 
 bool Graph::Contains(int64 nodeid) {
-  return nodemap_.find(nodeid) != nodemap_.end();
+  return nodemap_.Contains(nodeid);
 }
 
-std::unique_ptr<Graph::Node> Graph::Node::DeepCopy() {
+std::shared_ptr<Graph::Node> Graph::Node::DeepCopy() {
   // create a new node
-  std::unique_ptr<Node> result = std::unique_ptr<Node>(new Node());
-  // go through all the incoming and outgoing edges and insert them in the
-  // result. That's all there is to the state of the node, since we are not
-  // storing the id...
-  for(int64 v : *outgoing_) {
-    result->outgoing_->insert(v);
-  }
-  for(int64 v : *incoming_) {
-    result->incoming_->insert(v);
+  std::shared_ptr<Node> result = std::make_shared<Node>();
+  // copy the incoming and outgoing edges into the result. That's all there
+  // is to the state of the node, since we are not storing the id...
+  result->outgoing_ = outgoing_;
+  result->incoming_ = incoming_;
+  if(weights_ != nullptr) {
+    result->weights_ =
+      std::unique_ptr<FlatIdMap<double>>(new FlatIdMap<double>(*weights_));
   }
   return result;
 }
@@ -60,13 +126,16 @@ int64 Graph::AddNode() {
   while(Contains(id_counter)) {
     id_counter = (id_counter % max_int64) + 1;
   }
-  nodemap_.insert(std::make_pair(id_counter, std::unique_ptr<Node>(new Node())));
+  nodemap_.Insert(id_counter, std::make_shared<Node>());
+  components_.Insert(id_counter, ComponentLink{id_counter, 0});
   return id_counter;
 }
 
 int64 Graph::AddNode(int64 id) {
   if(!Contains(id)) {
-    nodemap_.insert(std::make_pair(id, std::unique_ptr<Node>(new Node())));
+    nodemap_.Insert(id, std::make_shared<Node>());
+    // a deleted node may have left its entry behind, which is fine
+    components_.Insert(id, ComponentLink{id, 0});
   }
   return id;
 }
@@ -80,17 +149,99 @@ void Graph::Connect(int64 from, int64 to) {
   // check if both nodes are in the graph
   if(Contains(from) && Contains(to)) {
     // insert the edge
-    nodemap_.at(from)->InsertOutgoing(to);
-    nodemap_.at(to)->InsertIncoming(from);
+    MutableNode(from)->InsertOutgoing(to, hash_threshold_);
+    MutableNode(to)->InsertIncoming(from, hash_threshold_);
+    UnionComponents(from, to);
+  }
+}
+
+void Graph::Connect(int64 from, int64 to, double weight) {
+  // also false for NaN
+  if(!(weight >= 0)) return;
+  if(Contains(from) && Contains(to)) {
+    Node* node = MutableNode(from);
+    node->InsertOutgoing(to, hash_threshold_);
+    node->SetWeight(to, weight);
+    MutableNode(to)->InsertIncoming(from, hash_threshold_);
+    UnionComponents(from, to);
+  }
+}
+
+double Graph::Weight(int64 from, int64 to) {
+  if(!Contains(from)) return std::numeric_limits<double>::infinity();
+  return nodemap_.at(from)->WeightTo(to);
+}
+
+void Graph::ConnectBatch(const std::vector<std::pair<int64, int64>>& edges,
+                         ThreadPool* pool) {
+  // a few shards per thread, so one shard full of hubs doesn't leave the
+  // other threads idle
+  int64 shards = pool == nullptr ? 1 : pool->size() * 4;
+  std::vector<Edge> sharded;
+  std::vector<int64> starts;
+  std::vector<Edge> batch;
+  batch.reserve(edges.size());
+  // Both passes below do the same thing, once keyed by source to fill the
+  // outgoing sets and once keyed by target to fill the incoming ones. The
+  // edges of a node all end up in one shard, and one shard belongs to one
+  // thread, so no two threads ever touch the same node.
+  for(int pass = 0; pass < 2; ++pass) {
+    batch.clear();
+    for(const Edge& edge : edges) {
+      if(!Contains(edge.first) || !Contains(edge.second)) continue;
+      batch.push_back(pass == 0 ? edge : Edge(edge.second, edge.first));
+    }
+    ShardAndSort(batch, shards, pool, &sharded, &starts);
+    auto insert_shards = [&](int thread, int64 begin, int64 end) {
+      std::vector<int64> ids;
+      for(int64 s = begin; s < end; ++s) {
+        int64 i = starts[s];
+        while(i < starts[s + 1]) {
+          // one run of edges with the same node, duplicates dropped
+          int64 node = sharded[i].first;
+          ids.clear();
+          for(; i < starts[s + 1] && sharded[i].first == node; ++i) {
+            if(ids.empty() || ids.back() != sharded[i].second) {
+              ids.push_back(sharded[i].second);
+            }
+          }
+          // each node is in one shard only, so this is the only thread
+          // that could be swapping out its slot
+          Node* n = MutableNode(node);
+          Adjacency& adjacency = pass == 0 ? n->outgoing_ : n->incoming_;
+          adjacency.InsertSorted(ids.data(), ids.size(), hash_threshold_);
+        }
+      }
+    };
+    ParallelFor(pool, shards, 1, insert_shards);
   }
+  // the last batch is the forward edges turned around, which doesn't
+  // matter here
+  for(const Edge& edge : batch) UnionComponents(edge.first, edge.second);
+}
+
+void Graph::AddAndConnectBatch(
+  const std::vector<std::pair<int64, int64>>& edges, ThreadPool* pool) {
+  std::vector<int64> ids;
+  ids.reserve(edges.size() * 2);
+  for(const Edge& edge : edges) {
+    ids.push_back(edge.first);
+    ids.push_back(edge.second);
+  }
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+  nodemap_.Reserve(nodemap_.size() + ids.size());
+  for(int64 id : ids) AddNode(id);
+  ConnectBatch(edges, pool);
 }
 
 void Graph::Disconnect(int64 from, int64 to) {
   // check if both nodes are in the graph
   if(Contains(from) && Contains(to)) {
     // delete the edge
-    nodemap_.at(from)->EraseOutgoing(to);
-    nodemap_.at(to)->EraseIncoming(from);
+    MutableNode(from)->EraseOutgoing(to);
+    MutableNode(to)->EraseIncoming(from);
+    NoteRemoval();
   }
 }
 
@@ -105,86 +256,259 @@ bool Graph::IsConnected(int64 from, int64 to) {
 Graph Graph::DeepCopy() {
   // make a new graph and copy over all nodes. The nodes have their own deep
   // copy method
-  auto result = Graph();
+  auto result = Graph(hash_threshold_);
+  result.components_ = components_;
+  result.stale_ = stale_;
+  result.nodemap_.Reserve(nodemap_.size());
   for(auto& kv : nodemap_) {
     // k -> id, v -> node
-    result.nodemap_.insert(std::make_pair(kv.first, kv.second->DeepCopy()));
+    result.nodemap_.Insert(kv.first, kv.second->DeepCopy());
   }
   return result;
 }
 
+Graph Graph::CowCopy() {
+  // copying the map copies the shared_ptrs, not the nodes
+  Graph result(hash_threshold_);
+  result.nodemap_ = nodemap_;
+  result.components_ = components_;
+  result.stale_ = stale_;
+  return result;
+}
+
+Graph::Node* Graph::Unshare(std::shared_ptr<Node>* node) {
+  // use_count is only a hint when other threads are copying the same
+  // pointer, but nobody can be making a new copy of *this* graph's
+  // pointer while we are modifying it, so 1 here really means ours alone.
+  // Seeing more than the real count only costs an unneeded copy.
+  if(node->use_count() > 1) {
+    *node = (*node)->DeepCopy();
+  }
+  return node->get();
+}
+
+Graph::Node* Graph::MutableNode(int64 id) {
+  return Unshare(&nodemap_.at(id));
+}
+
 void Graph::Reverse(Graph* graph_to_reverse) {
   // all this does is swap the incoming and outgoing sets for each node
   auto& nodemap_ = graph_to_reverse->nodemap_;
-  for(std::pair<const int64, std::unique_ptr<Node>>& kv : nodemap_) {
+  // ...except for the weights, which live with the outgoing edges and so
+  // have to move to the other end of their edge.
+  std::vector<std::pair<int64, WeightedEdge>> weighted;
+  for(std::pair<int64, std::shared_ptr<Node>>& kv : nodemap_) {
+    if(kv.second->weights_ == nullptr) continue;
+    for(const std::pair<int64, double>& edge : *kv.second->weights_) {
+      weighted.push_back(std::make_pair(edge.first,
+                                        WeightedEdge{kv.first, edge.second}));
+    }
+  }
+  for(std::pair<int64, std::shared_ptr<Node>>& kv : nodemap_) {
     // k -> id, v -> node pointer. We don't care about k here...
-    kv.second->outgoing_.swap(kv.second->incoming_);
-  } 
+    Node* node = Unshare(&kv.second);
+    node->outgoing_.swap(node->incoming_);
+    node->weights_.reset();
+  }
+  for(const std::pair<int64, WeightedEdge>& kv : weighted) {
+    graph_to_reverse->MutableNode(kv.first)->SetWeight(kv.second.target,
+                                                        kv.second.weight);
+  }
 }
 
 void Graph::Delete(int64 node) {
   // if the node is in the graph... 
   if(Contains(node)) {
     // get the set of nodes which have an edge to it... 
-    for(int64 id : *(nodemap_.at(node)->incoming_)) {
+    // hold on to it, so it stays put even if a self loop makes us unshare
+    // it halfway through
+    std::shared_ptr<Node> deleted = nodemap_.at(node);
+    deleted->incoming_.ForEach([this, node](int64 id) {
       // delete the pointer to this node from those nodes...
-      nodemap_.at(id)->EraseOutgoing(node);
-    }
+      MutableNode(id)->EraseOutgoing(node);
+    });
+    // same thing for the nodes it points to, otherwise they would keep an
+    // incoming edge from a node that does not exist anymore
+    deleted->outgoing_.ForEach([this, node](int64 id) {
+      MutableNode(id)->EraseIncoming(node);
+    });
     // and finally get rid of the node
-    nodemap_.erase(node);
+    nodemap_.Erase(node);
+    NoteRemoval();
   }
 }
 
-// This is going to a simple breadth first search
+int64 Graph::FindComponent(int64 id) const {
+  // no path compression here, so this can run next to other readers
+  int64 parent = components_.Find(id)->parent;
+  while(parent != id) {
+    id = parent;
+    parent = components_.Find(id)->parent;
+  }
+  return id;
+}
+
+void Graph::UnionComponents(int64 a, int64 b) {
+  a = FindComponent(a);
+  b = FindComponent(b);
+  if(a == b) return;
+  ComponentLink* link_a = components_.Find(a);
+  ComponentLink* link_b = components_.Find(b);
+  // the shallower tree goes under the deeper one
+  if(link_a->rank < link_b->rank) {
+    link_a->parent = b;
+  } else {
+    link_b->parent = a;
+    if(link_a->rank == link_b->rank) ++link_a->rank;
+  }
+}
+
+void Graph::NoteRemoval() {
+  if(++stale_ > Count()) RebuildComponents();
+}
+
+void Graph::RebuildComponents() {
+  components_.Clear();
+  components_.Reserve(nodemap_.size());
+  for(auto& kv : nodemap_) {
+    components_.Insert(kv.first, ComponentLink{kv.first, 0});
+  }
+  for(auto& kv : nodemap_) {
+    int64 from = kv.first;
+    kv.second->outgoing_.ForEach([this, from](int64 to) {
+      UnionComponents(from, to);
+    });
+  }
+  stale_ = 0;
+}
+
+// This is a breadth first search from both ends (see
+// bidirectional_search.hpp). That is where the incoming sets pay off.
 std::vector<int64> Graph::ShortestPath(int64 from, int64 to) {
-  std::vector<int64> result = std::vector<int64>();
-  // no point doing anything if the nodes are not in the graph
-  if(!Contains(from) || !Contains(to)) return result;
-  // we need a way to keep track of things we have already visited
-  std::unordered_set<int64> visited;
-  // and a way to keep track of how we visited them, so each node keeps
-  // track of where it came from
-  std::map<int64, int64> backpointers;
-  // just for consistency...
-  backpointers.insert({from, -1});
-  // a queue to visit the nodes in the right order
-  std::queue<int64> q;
-  q.push(from);
-  // while the queue is not empty...
-  while(!q.empty()) {
-    // get the most current element...
-    int64 current = q.front();
-    visited.insert(current);
-    q.pop();
-    // if we have reached the destination, we are done
-    if(current == to) break;
-    // else, we add all our neighbors to the queue
-    for(int64 neighbor : *(nodemap_.at(current)->outgoing_)) {
-      // do not need to do anything if the neighbor has been visited before
-      if(visited.find(neighbor) == visited.end()) {
-        backpointers.insert({neighbor, current});
-        q.push(neighbor);
-      }
+  // no point doing anything if the nodes are not in the graph, or if
+  // there's no way to get from one to the other even ignoring directions
+  if(!Contains(from) || !Contains(to) ||
+     FindComponent(from) != FindComponent(to)) {
+    return std::vector<int64>();
+  }
+  auto successors = [this](int64 id, auto&& f) {
+    nodemap_.at(id)->outgoing_.ForEach(f);
+  };
+  auto predecessors = [this](int64 id, auto&& f) {
+    nodemap_.at(id)->incoming_.ForEach(f);
+  };
+  return BidirectionalSearch(from, to, successors, predecessors);
+}
+
+// Dijkstra, stopping as soon as the target comes off the heap. Nodes can
+// be pushed more than once; the stale entries are skipped when they come
+// out, which is cheaper than a heap that supports decrease-key.
+std::vector<int64> Graph::WeightedShortestPath(int64 from, int64 to) {
+  std::vector<int64> result;
+  if(!Contains(from) || !Contains(to) ||
+     FindComponent(from) != FindComponent(to)) {
+    return result;
+  }
+  typedef std::pair<double, int64> Entry;
+  DaryHeap<Entry, 4, std::less<Entry>> heap;
+  FlatIdMap<double> distance;
+  FlatIdMap<int64> parent;
+  distance.Insert(from, 0.0);
+  parent.Insert(from, from);
+  heap.push(Entry(0.0, from));
+  bool found = false;
+  while(!heap.empty()) {
+    Entry top = heap.top();
+    heap.pop();
+    int64 u = top.second;
+    if(top.first > distance.at(u)) continue;
+    if(u == to) {
+      found = true;
+      break;
     }
+    ForEachWeightedSuccessor(u, [&](int64 v, double weight) {
+      double through = top.first + weight;
+      double* known = distance.Find(v);
+      if(known != nullptr && *known <= through) return;
+      distance[v] = through;
+      parent[v] = u;
+      heap.push(Entry(through, v));
+    });
+  }
+  if(!found) return result;
+  for(int64 v = to; v != from; v = parent.at(v)) result.push_back(v);
+  result.push_back(from);
+  std::reverse(result.begin(), result.end());
+  return result;
+}
+
+CsrGraph Graph::Freeze() {
+  std::unique_ptr<CsrGraph::Storage> storage(new CsrGraph::Storage());
+  std::vector<int64>& ids = storage->ids;
+  std::vector<int64>& out_offsets = storage->out_offsets;
+  std::vector<int32>& out_targets = storage->out_targets;
+  std::vector<int64>& in_offsets = storage->in_offsets;
+  std::vector<int32>& in_targets = storage->in_targets;
+  int64 count = nodemap_.size();
+  // the node map is not ordered, but CsrGraph::IndexOf wants dense indices
+  // handed out in id order, so sort the ids first
+  ids = nodemap_.SortedKeys();
+  // a throwaway id -> index table, so translating an edge is one probe
+  // instead of a binary search
+  FlatIdMap<int32> index_of;
+  index_of.Reserve(count);
+  for(int32 i = 0; i < count; ++i) {
+    index_of.Insert(ids[i], i);
   }
-  // first check if we ever reached the end
-  if(visited.find(to) != visited.end()) {
-    // then get the length of the shortest path
-    // the reason for doing this is so that we know where to start filling
-    // up the vector and do not have to do expensive inserts.
-    int64 current = to;
-    int64 shortestPathLength = 1;
-    while(current != from) {
-      shortestPathLength += 1;
-      current = backpointers.at(current);
+  // first pass: offsets are running sums of the degrees
+  out_offsets.resize(count + 1);
+  in_offsets.resize(count + 1);
+  for(int32 i = 0; i < count; ++i) {
+    Node* node = nodemap_.at(ids[i]).get();
+    out_offsets[i + 1] = out_offsets[i] + node->outgoing_.size();
+    in_offsets[i + 1] = in_offsets[i] + node->incoming_.size();
+  }
+  // weights are only worth storing if some node has them
+  bool weighted = false;
+  for(auto& kv : nodemap_) {
+    if(kv.second->weights_ != nullptr && kv.second->weights_->size() > 0) {
+      weighted = true;
+      break;
     }
-    // now insert the result in the vector
-    result.resize(shortestPathLength);
-    current = to;
-    for(int i = shortestPathLength - 1; i >= 0; --i) {
-      result[i] = current;
-      current = backpointers.at(current);
+  }
+  std::vector<double>& out_weights = storage->out_weights;
+  if(weighted) out_weights.resize(out_offsets[count]);
+  // second pass: translate the neighbor ids and sort each row
+  out_targets.resize(out_offsets[count]);
+  in_targets.resize(in_offsets[count]);
+  for(int32 i = 0; i < count; ++i) {
+    Node* node = nodemap_.at(ids[i]).get();
+    int64 out = out_offsets[i];
+    node->outgoing_.ForEach([&](int64 v) {
+      out_targets[out++] = index_of.at(v);
+    });
+    std::sort(out_targets.begin() + out_offsets[i], out_targets.begin() + out);
+    if(weighted) {
+      const FlatIdMap<double>* weights = node->weights_.get();
+      for(int64 e = out_offsets[i]; e < out; ++e) {
+        const double* weight = weights == nullptr ? nullptr :
+          weights->Find(ids[out_targets[e]]);
+        out_weights[e] = weight == nullptr ? 1.0 : *weight;
+      }
     }
+    if(weighted) continue;
+    int64 in = in_offsets[i];
+    node->incoming_.ForEach([&](int64 v) {
+      in_targets[in++] = index_of.at(v);
+    });
+    std::sort(in_targets.begin() + in_offsets[i], in_targets.begin() + in);
   }
-  return result;
+  // the incoming weights would each take a lookup in another node, the
+  // transpose of the outgoing rows gets them in one sweep
+  if(weighted) {
+    CsrGraph::Transpose(count, out_offsets.data(), out_targets.data(),
+                        out_weights.data(), &in_offsets, &in_targets,
+                        &storage->in_weights);
+  }
+  return CsrGraph(std::move(storage));
 }
@@ -1,15 +1,32 @@
 #ifndef GRAPH_H_INCLUDE
 #define GRAPH_H_INCLUDE
 #include<vector>
-#include<map>
-#include<unordered_set>
 #include<memory>
+#include<utility>
+#include "flat_id_map.hpp"
+#include "adjacency.hpp"
 
 typedef long long int64;
 
+class CsrGraph;
+class ThreadPool;
+
+// One outgoing edge of a node and what it costs to take it, see
+// Graph::Connect(from, to, weight).
+struct WeightedEdge {
+  int64 target;
+  double weight;
+};
+
 class Graph {
 
  public:
+  // An empty graph. hash_threshold is the degree above which a node's
+  // edge set switches from a sorted array to a hash set (see
+  // adjacency.hpp); the default is right for almost everything.
+  Graph();
+  explicit Graph(int64 hash_threshold);
+
   // Reverse all the connections in the graph. This should make it
   // so that original.IsConnected(a, b) = true if and only if
   // reversed.IsConnected(b, a) = true. I made this method static just
@@ -36,6 +53,31 @@ class Graph {
   // not commutative (i.e. Connect(1, 2) != Connect(2, 1)).
   void Connect(int64 from, int64 to);
 
+  // Same, but the edge gets a weight: the cost of taking it in
+  // WeightedShortestPath. Connecting an edge that is already there just
+  // changes its weight. Edges made any other way weigh 1. A negative or
+  // NaN weight is refused: the graph is left as it was, the same as when
+  // one of the nodes is missing.
+  void Connect(int64 from, int64 to, double weight);
+
+  // Returns the weight of the edge from -> to, or infinity if there is
+  // no such edge.
+  double Weight(int64 from, int64 to);
+
+  // Connects every (from, to) pair in edges, as if calling Connect on each
+  // of them, but much faster for big batches: the edges are grouped by
+  // node so each edge set grows once per batch instead of once per edge.
+  // Pairs whose nodes are not in the graph are skipped, like Connect does.
+  // With a pool, the work is split into shards of nodes that are filled in
+  // in parallel; pool may be nullptr.
+  void ConnectBatch(const std::vector<std::pair<int64, int64>>& edges,
+                    ThreadPool* pool);
+
+  // Same as ConnectBatch, but first adds any node that shows up in edges
+  // and is not in the graph yet.
+  void AddAndConnectBatch(const std::vector<std::pair<int64, int64>>& edges,
+                          ThreadPool* pool);
+
   // Removes a connection from one node to another. If no
   // connection existed before, does nothing. This should also
   // be directional, so if there's a two-way connection between
@@ -52,6 +94,15 @@ class Graph {
   //    original.IsConnected(a, b) for all a, b.
   Graph DeepCopy();
 
+  // Returns a copy of the graph that shares every node's edge sets with
+  // this one instead of copying them. A node is only really copied the
+  // first time either graph changes it (Connect, Disconnect, Delete,
+  // Reverse, ...), so this is cheap even for huge graphs and is the way to
+  // go for throwaway what-if edits. The copy still allocates the node
+  // index, which is one pointer per node. Behaves exactly like DeepCopy
+  // otherwise.
+  Graph CowCopy();
+
   // Deletes a node and all of its incoming and outgoing connections.
   void Delete(int64 node);
 
@@ -59,6 +110,43 @@ class Graph {
   // path exists, return an empty vector.
   std::vector<int64> ShortestPath(int64 from, int64 to);
 
+  // Return the path between two nodes with the smallest total weight
+  // (Dijkstra with a 4-ary heap). If no path exists, return an empty
+  // vector.
+  std::vector<int64> WeightedShortestPath(int64 from, int64 to);
+
+  // Calls f(id) for every node that id has an edge to (successors) or
+  // that has an edge to id (predecessors). Does nothing if there is no
+  // node with that id. Do not change the graph from inside f.
+  template<typename F>
+  void ForEachSuccessor(int64 id, F f) {
+    if(Contains(id)) nodemap_.at(id)->outgoing_.ForEach(f);
+  }
+  template<typename F>
+  void ForEachPredecessor(int64 id, F f) {
+    if(Contains(id)) nodemap_.at(id)->incoming_.ForEach(f);
+  }
+
+  // Calls f(v, weight) for every edge id -> v.
+  template<typename F>
+  void ForEachWeightedSuccessor(int64 id, F f) {
+    if(!Contains(id)) return;
+    Node* node = nodemap_.at(id).get();
+    const FlatIdMap<double>* weights = node->weights_.get();
+    if(weights == nullptr) {
+      node->outgoing_.ForEach([&f](int64 v) { f(v, 1.0); });
+    } else {
+      node->outgoing_.ForEach([&f, weights](int64 v) {
+        const double* weight = weights->Find(v);
+        f(v, weight == nullptr ? 1.0 : *weight);
+      });
+    }
+  }
+
+  // Returns an immutable compressed sparse row snapshot of the current
+  // graph (see csr_graph.hpp). Later changes to this graph do not show up
+  // in the snapshot, so re-freeze after editing.
+  CsrGraph Freeze();
 
  private:
   // Nested class representing node in the graph to manage connections
@@ -67,34 +155,82 @@ class Graph {
     // These represent incoming and outgoing edges.
     friend class Graph;
    public:
-    Node() :
-      outgoing_(new std::unordered_set<int64>()),
-      incoming_(new std::unordered_set<int64>()) {}
+    Node() {}
     // A bunch of mutator methods to add/delete incoming/outgoing edges from
     // node
-    void InsertOutgoing(int64 to);
-    void InsertIncoming(int64 from);
+    void InsertOutgoing(int64 to, int64 hash_threshold);
+    void InsertIncoming(int64 from, int64 hash_threshold);
     void EraseOutgoing(int64 to);
     void EraseIncoming(int64 from);
+    // Weights of outgoing edges. SetWeight expects the edge to be there
+    // already.
+    void SetWeight(int64 to, double weight);
+    double WeightTo(int64 to);
     // Two accessor methods. Return true if there exists an incoming/outgoing
     // edge
     bool ContainsEdgeFrom(int64 from);
     bool ContainsEdgeTo(int64 to);
-    std::unique_ptr<Node> DeepCopy();
+    std::shared_ptr<Node> DeepCopy();
    private:
     // Reasons for having both sets:
     // 1. When a node is deleted, this makes it finding out which edges to
     //    delete much easier
     // 2. This makes reverse a lot easier
-    std::unique_ptr<std::unordered_set<int64>> outgoing_;
-    std::unique_ptr<std::unordered_set<int64>> incoming_;
+    // These used to be heap allocated unordered_sets, which cost a couple
+    // hundred bytes per node before there was a single edge. Adjacency
+    // keeps small sets inline.
+    Adjacency outgoing_;
+    Adjacency incoming_;
+    // The weights of the outgoing edges that don't weigh 1, by target.
+    // Hashed like a big outgoing_, so setting a weight on a hub is O(1),
+    // and edges added or erased without a weight need no bookkeeping.
+    // nullptr until some edge gets another weight, which keeps unweighted
+    // nodes as cheap as before.
+    std::unique_ptr<FlatIdMap<double>> weights_;
   };
 
   // method to check if there is a certain node in the graph
   bool Contains(int64 nodeID);
 
-  // collection of nodes, mapping ids to nodes
-  std::map<int64, std::unique_ptr<Node>> nodemap_;
+  // Weakly connected components (edge directions ignored), kept up to date
+  // by everything that adds edges, so that ShortestPath can turn down two
+  // nodes in different components right away instead of searching all
+  // that can be reached from one of them. It is a union-find over node
+  // ids, with union by rank so lookups that don't compress paths are
+  // still short; the lookups are read only, which keeps ShortestPath safe
+  // to call from several threads at once.
+  //
+  // A union-find can't split a component, so after Disconnect or Delete
+  // it may still put two nodes together that aren't connected anymore
+  // (deleted nodes even keep their entries). That only costs a search
+  // that finds nothing, the way it was before. Once there have been as
+  // many removals as there are nodes, it is rebuilt from scratch.
+  struct ComponentLink {
+    int64 parent;
+    int rank;
+  };
+  int64 FindComponent(int64 id) const;
+  void UnionComponents(int64 a, int64 b);
+  void NoteRemoval();
+  void RebuildComponents();
+
+  // Nodes can be shared with copies made by CowCopy, so anything that
+  // changes a node has to get at it through one of these. If the node is
+  // shared, it gets copied first and this graph switches to the copy.
+  Node* MutableNode(int64 id);
+  static Node* Unshare(std::shared_ptr<Node>* node);
+
+  // collection of nodes, mapping ids to nodes. This is a flat open
+  // addressing table, so it does not iterate in id order. The nodes are
+  // shared_ptrs so that CowCopy can share them between graphs.
+  FlatIdMap<std::shared_ptr<Node>> nodemap_;
+
+  // degree at which node edge sets switch to hashing
+  int64 hash_threshold_;
+
+  FlatIdMap<ComponentLink> components_;
+  // removals since components_ was last rebuilt
+  int64 stale_;
 
 };
 
@@ -0,0 +1,148 @@
+#include "kcore.hpp"
+#include<vector>
+#include<algorithm>
+#include<atomic>
+#include<memory>
+#include<cstdint>
+
+namespace {
+
+// rounds smaller than this are peeled on the calling thread, waking the
+// pool costs more than it saves
+const size_t kParallelRound = 1024;
+
+// The number of neighbors either way, self loops left out.
+std::vector<int32> Degrees(const CsrGraph& both) {
+  std::vector<int32> degree(both.Count());
+  for(int32 v = 0; v < both.Count(); ++v) {
+    CsrGraph::Neighbors row = both.OutNeighbors(v);
+    degree[v] = row.size() -
+      (std::binary_search(row.begin(), row.end(), v) ? 1 : 0);
+  }
+  return degree;
+}
+
+}  // namespace
+
+std::vector<int32> CoreNumbers(const CsrGraph& graph) {
+  CsrGraph both = graph.Symmetrized();
+  int32 count = both.Count();
+  // degree[v] ends up as the core number
+  std::vector<int32> degree = Degrees(both);
+  int32 max_degree = 0;
+  for(int32 d : degree) max_degree = std::max(max_degree, d);
+  // start[d] is where the nodes of degree d begin in order, position[v]
+  // is where v is in it
+  std::vector<int32> start(max_degree + 2, 0);
+  for(int32 d : degree) ++start[d + 1];
+  for(int32 d = 0; d <= max_degree; ++d) start[d + 1] += start[d];
+  std::vector<int32> order(count);
+  std::vector<int32> position(count);
+  {
+    std::vector<int32> fill(start.begin(), start.end() - 1);
+    for(int32 v = 0; v < count; ++v) {
+      position[v] = fill[degree[v]]++;
+      order[position[v]] = v;
+    }
+  }
+  for(int32 i = 0; i < count; ++i) {
+    int32 v = order[i];
+    for(int32 w : both.OutNeighbors(v)) {
+      if(degree[w] <= degree[v]) continue;
+      // swap w with the first node of its bucket, then shrink the bucket
+      // from the front, which puts w at the end of the one below
+      int32 d = degree[w];
+      int32 first = order[start[d]];
+      if(first != w) {
+        std::swap(order[position[w]], order[start[d]]);
+        std::swap(position[w], position[first]);
+      }
+      ++start[d];
+      --degree[w];
+    }
+  }
+  return degree;
+}
+
+std::vector<int32> ParallelCoreNumbers(const CsrGraph& graph,
+                                       ThreadPool* pool) {
+  CsrGraph both = graph.Symmetrized();
+  int32 count = both.Count();
+  std::vector<int32> initial = Degrees(both);
+  std::unique_ptr<std::atomic<int32>[]> degree(new std::atomic<int32>[count]);
+  for(int32 v = 0; v < count; ++v) degree[v].store(initial[v]);
+  std::vector<int32> core(count, -1);
+  std::vector<int32> remaining(count);
+  for(int32 v = 0; v < count; ++v) remaining[v] = v;
+  int threads = pool == nullptr ? 1 : pool->size();
+  std::vector<std::vector<int32>> next(threads);
+  std::vector<int32> round;
+  int32 level = 0;
+
+  // removes every node of round at this level, and collects the nodes it
+  // takes down to the level into next
+  auto peel = [&](int thread, int64 begin, int64 end) {
+    for(int64 i = begin; i < end; ++i) {
+      int32 v = round[i];
+      core[v] = level;
+      for(int32 w : both.OutNeighbors(v)) {
+        // nodes at or below the level are removed or about to be, their
+        // degree doesn't matter anymore
+        if(w == v || degree[w].load(std::memory_order_relaxed) <= level) {
+          continue;
+        }
+        if(degree[w].fetch_sub(1, std::memory_order_relaxed) == level + 1) {
+          next[thread].push_back(w);
+        }
+      }
+    }
+  };
+
+  while(!remaining.empty()) {
+    // the nodes at or below the level start it, the rest wait. Levels
+    // nobody is left at are skipped.
+    int32 lowest = INT32_MAX;
+    for(int32 v : remaining) {
+      lowest = std::min(lowest, degree[v].load(std::memory_order_relaxed));
+    }
+    level = std::max(level, lowest);
+    round.clear();
+    size_t kept = 0;
+    for(int32 v : remaining) {
+      if(degree[v].load(std::memory_order_relaxed) <= level) {
+        round.push_back(v);
+      } else {
+        remaining[kept++] = v;
+      }
+    }
+    remaining.resize(kept);
+    while(!round.empty()) {
+      ParallelFor(round.size() < kParallelRound ? nullptr : pool,
+                  round.size(), 256, peel);
+      round.clear();
+      for(std::vector<int32>& found : next) {
+        round.insert(round.end(), found.begin(), found.end());
+        found.clear();
+      }
+    }
+    // nodes a round took down are gone from remaining only now
+    kept = 0;
+    for(int32 v : remaining) {
+      if(core[v] == -1) remaining[kept++] = v;
+    }
+    remaining.resize(kept);
+  }
+  return core;
+}
+
+FlatIdMap<int32> CoreNumbers(Graph* graph, ThreadPool* pool) {
+  CsrGraph frozen = graph->Freeze();
+  std::vector<int32> core = pool == nullptr ?
+    CoreNumbers(frozen) : ParallelCoreNumbers(frozen, pool);
+  FlatIdMap<int32> result;
+  result.Reserve(frozen.Count());
+  for(int32 v = 0; v < frozen.Count(); ++v) {
+    result.Insert(frozen.IdOf(v), core[v]);
+  }
+  return result;
+}
@@ -0,0 +1,36 @@
+#ifndef KCORE_H_INCLUDE
+#define KCORE_H_INCLUDE
+#include<vector>
+#include "graph.hpp"
+#include "csr_graph.hpp"
+#include "flat_id_map.hpp"
+#include "thread_pool.hpp"
+
+// k-core decomposition of a CsrGraph, with edge directions ignored and
+// self loops left out. The k-core is what is left after deleting, over
+// and over, every node with fewer than k neighbors; the core number of a
+// node is the largest k whose k-core still has it. Core numbers are
+// indexed by dense index, except for the Graph overload at the end.
+
+// Batagelj and Zaversnik's peeling in O(n + m): nodes sit in an array
+// sorted by current degree with the start of every degree bucket known,
+// so taking the node of smallest degree and lowering a neighbor's degree
+// (swapping it to the front of its bucket and moving the bucket start
+// past it) are both constant time.
+std::vector<int32> CoreNumbers(const CsrGraph& graph);
+
+// The same result, peeled in parallel one level at a time. At level k,
+// every node left with degree <= k is removed at once, spread over the
+// pool; each removal decrements its neighbors' degrees atomically, and
+// the thread whose decrement takes a neighbor down to k adds it to the
+// next round of the same level. Rounds go on until the level is empty.
+// Worth it for big graphs with low core numbers; graphs with a few
+// thousand levels spend most of their time waiting between rounds.
+std::vector<int32> ParallelCoreNumbers(const CsrGraph& graph,
+                                       ThreadPool* pool);
+
+// Core numbers straight by node id, for a Graph. Uses the parallel
+// version if there is a pool, the serial one otherwise.
+FlatIdMap<int32> CoreNumbers(Graph* graph, ThreadPool* pool);
+
+#endif
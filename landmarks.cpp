@@ -0,0 +1,225 @@
+#include "landmarks.hpp"
+#include "bfs.hpp"
+#include "dary_heap.hpp"
+#include "csr_snapshot.hpp"
+#include "flat_id_map.hpp"
+#include<vector>
+#include<string>
+#include<fstream>
+#include<cstring>
+#include<cstdint>
+#include<algorithm>
+#include<functional>
+#include<utility>
+
+namespace {
+
+const char kLandmarkMagic[8] = {'F', 'W', 'G', 'A', 'L', 'T', '\0', '\0'};
+const uint32_t kLandmarkVersion = 1;
+
+// What a saved index starts with. The three arrays follow right after it:
+// landmarks int32[k], then the from and to tables, int32[node_count * k]
+// each, in the same node major order as in memory.
+struct LandmarkHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t k;
+  int64_t node_count;
+  int64_t edge_count;
+  // SnapshotChecksum of each of the three arrays
+  uint64_t checksums[3];
+};
+
+// One node touched by an A* search.
+struct Visit {
+  int32 distance;
+  int32 parent;
+  bool done;
+};
+
+}  // namespace
+
+const int32 LandmarkIndex::kNoPath;
+
+LandmarkIndex::LandmarkIndex() : count_(0), edge_count_(0) {}
+
+LandmarkIndex LandmarkIndex::Build(const CsrGraph& graph, int k) {
+  LandmarkIndex index;
+  int64 count = graph.Count();
+  index.count_ = count;
+  index.edge_count_ = graph.EdgeCount();
+  k = std::min<int64>(std::max(k, 0), count);
+  if(k == 0) return index;
+  index.from_landmark_.assign(count * k, -1);
+  index.to_landmark_.assign(count * k, -1);
+  CsrGraph reversed = graph.Reversed();
+  // how close each node is to the nearest landmark so far, either way.
+  // Nodes no landmark has reached yet are the farthest of all, that is
+  // how every component ends up with a landmark if k allows.
+  std::vector<int32> nearest(count, kNoPath);
+  // start from the best connected node. The next ones are picked as far
+  // as possible from it, out at the edges of the graph, where landmarks
+  // give the best bounds.
+  int32 next = 0;
+  for(int32 v = 1; v < count; ++v) {
+    if(graph.OutDegree(v) + graph.InDegree(v) >
+       graph.OutDegree(next) + graph.InDegree(next)) {
+      next = v;
+    }
+  }
+  for(int l = 0; l < k; ++l) {
+    int32 landmark = next;
+    index.landmarks_.push_back(landmark);
+    std::vector<int32> forward = DirectionOptimizingBfs(graph, landmark).distance;
+    std::vector<int32> backward =
+      DirectionOptimizingBfs(reversed, landmark).distance;
+    for(int32 v = 0; v < count; ++v) {
+      int64 slot = static_cast<int64>(v) * k + l;
+      index.from_landmark_[slot] = forward[v];
+      index.to_landmark_[slot] = backward[v];
+      if(forward[v] != -1) nearest[v] = std::min(nearest[v], forward[v]);
+      if(backward[v] != -1) nearest[v] = std::min(nearest[v], backward[v]);
+    }
+    next = std::max_element(nearest.begin(), nearest.end()) - nearest.begin();
+  }
+  return index;
+}
+
+int32 LandmarkIndex::LowerBound(int32 v, int32 t) const {
+  int k = landmarks_.size();
+  const int32* from_v = from_landmark_.data() + static_cast<int64>(v) * k;
+  const int32* from_t = from_landmark_.data() + static_cast<int64>(t) * k;
+  const int32* to_v = to_landmark_.data() + static_cast<int64>(v) * k;
+  const int32* to_t = to_landmark_.data() + static_cast<int64>(t) * k;
+  int32 bound = 0;
+  for(int l = 0; l < k; ++l) {
+    // the tables can also prove there is no path: if L reaches v but not
+    // t, v can't reach t either, and the same if t reaches L but v doesn't
+    if(from_v[l] != -1) {
+      if(from_t[l] == -1) return kNoPath;
+      bound = std::max(bound, from_t[l] - from_v[l]);
+    }
+    if(to_t[l] != -1) {
+      if(to_v[l] == -1) return kNoPath;
+      bound = std::max(bound, to_v[l] - to_t[l]);
+    }
+  }
+  return bound;
+}
+
+// A* on dense indices. The landmark bounds are consistent (they never
+// drop by more than one along an edge), so a node's distance is final
+// when it comes off the heap, just like in Dijkstra. The search state
+// lives in a hash map rather than Count() sized arrays, because the whole
+// point is to touch only a small part of the graph.
+std::vector<int64> LandmarkIndex::ShortestPath(const CsrGraph& graph,
+                                               int64 from, int64 to) const {
+  std::vector<int64> result;
+  int32 source = graph.IndexOf(from);
+  int32 target = graph.IndexOf(to);
+  if(source == -1 || target == -1) return result;
+  if(LowerBound(source, target) == kNoPath) return result;
+  // (estimated length, -distance so far, node): among equal estimates,
+  // expand the node that got furthest first, it is probably closer
+  typedef std::pair<std::pair<int32, int32>, int32> Entry;
+  DaryHeap<Entry, 4, std::less<Entry>> heap;
+  FlatIdMap<Visit> visits;
+  visits.Insert(source, Visit{0, source, false});
+  heap.push(Entry(std::make_pair(LowerBound(source, target), 0), source));
+  bool found = false;
+  while(!heap.empty()) {
+    int32 u = heap.top().second;
+    heap.pop();
+    Visit& visit = visits.at(u);
+    if(visit.done) continue;
+    visit.done = true;
+    if(u == target) {
+      found = true;
+      break;
+    }
+    int32 through = visit.distance + 1;
+    for(int32 v : graph.OutNeighbors(u)) {
+      Visit* seen = visits.Find(v);
+      if(seen != nullptr && seen->distance <= through) continue;
+      int32 bound = LowerBound(v, target);
+      if(bound == kNoPath) continue;
+      if(seen == nullptr) {
+        visits.Insert(v, Visit{through, u, false});
+      } else {
+        *seen = Visit{through, u, false};
+      }
+      heap.push(Entry(std::make_pair(through + bound, -through), v));
+    }
+  }
+  if(!found) return result;
+  for(int32 v = target; v != source; v = visits.at(v).parent) {
+    result.push_back(graph.IdOf(v));
+  }
+  result.push_back(from);
+  std::reverse(result.begin(), result.end());
+  return result;
+}
+
+bool LandmarkIndex::Save(const std::string& path) const {
+  LandmarkHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kLandmarkMagic, sizeof(header.magic));
+  header.version = kLandmarkVersion;
+  header.k = landmarks_.size();
+  header.node_count = count_;
+  header.edge_count = edge_count_;
+  const std::vector<int32>* arrays[3] = {
+    &landmarks_, &from_landmark_, &to_landmark_};
+  for(int a = 0; a < 3; ++a) {
+    header.checksums[a] = SnapshotChecksum(
+      reinterpret_cast<const char*>(arrays[a]->data()),
+      arrays[a]->size() * sizeof(int32));
+  }
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if(!out) return false;
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  for(int a = 0; a < 3; ++a) {
+    out.write(reinterpret_cast<const char*>(arrays[a]->data()),
+              arrays[a]->size() * sizeof(int32));
+  }
+  out.close();
+  return !out.fail();
+}
+
+bool LandmarkIndex::Load(const std::string& path, const CsrGraph& graph,
+                         LandmarkIndex* index) {
+  std::ifstream in(path, std::ios::binary);
+  if(!in) return false;
+  LandmarkHeader header;
+  if(!in.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+  // an index only makes sense for the graph it was built for. Node and
+  // edge counts are a cheap way to catch most mixups.
+  if(std::memcmp(header.magic, kLandmarkMagic, sizeof(header.magic)) != 0 ||
+     header.version != kLandmarkVersion ||
+     header.node_count != graph.Count() ||
+     header.edge_count != graph.EdgeCount() ||
+     header.k > static_cast<uint64_t>(graph.Count())) {
+    return false;
+  }
+  LandmarkIndex result;
+  result.count_ = header.node_count;
+  result.edge_count_ = header.edge_count;
+  result.landmarks_.resize(header.k);
+  result.from_landmark_.resize(header.node_count * header.k);
+  result.to_landmark_.resize(header.node_count * header.k);
+  std::vector<int32>* arrays[3] = {
+    &result.landmarks_, &result.from_landmark_, &result.to_landmark_};
+  for(int a = 0; a < 3; ++a) {
+    char* data = reinterpret_cast<char*>(arrays[a]->data());
+    uint64_t bytes = arrays[a]->size() * sizeof(int32);
+    if(!in.read(data, bytes) ||
+       SnapshotChecksum(data, bytes) != header.checksums[a]) {
+      return false;
+    }
+  }
+  for(int32 landmark : result.landmarks_) {
+    if(landmark < 0 || landmark >= graph.Count()) return false;
+  }
+  *index = std::move(result);
+  return true;
+}
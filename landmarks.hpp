@@ -0,0 +1,70 @@
+#ifndef LANDMARKS_H_INCLUDE
+#define LANDMARKS_H_INCLUDE
+#include<vector>
+#include<string>
+#include<limits>
+#include "csr_graph.hpp"
+
+// Goal directed point to point search for graphs that are queried a lot
+// and change rarely: A* with landmarks and the triangle inequality (ALT,
+// Goldberg and Harrelson).
+//
+// Preprocessing picks k landmark nodes and runs a BFS from each of them
+// over the outgoing edges and one over the incoming edges, so we know
+// d(L, v) and d(v, L) for every node v. For any landmark L,
+//   d(v, t) >= d(L, t) - d(L, v)   and   d(v, t) >= d(v, L) - d(t, L)
+// so the largest of these over all landmarks is a lower bound on the
+// distance left to the target, which steers A* towards it. Landmarks are
+// picked far apart from each other (each one as far as possible from the
+// ones before it), which is what makes the bounds tight.
+//
+// The index belongs to one snapshot and works on its dense indices; it
+// has to be rebuilt (or reloaded) when the graph changes. Save and Load
+// keep it across restarts.
+class LandmarkIndex {
+ public:
+  // LowerBound's answer when there is no path at all.
+  static const int32 kNoPath = std::numeric_limits<int32>::max();
+
+  // An empty index, with no landmarks. Its bounds are all 0, so
+  // ShortestPath is a plain best first search.
+  LandmarkIndex();
+
+  // Picks up to k landmarks in graph and computes their distance tables,
+  // 2k BFS runs in all. Takes about 8 bytes per node per landmark.
+  static LandmarkIndex Build(const CsrGraph& graph, int k);
+
+  // Writes the index to a binary file. Returns false if the file can't be
+  // written.
+  bool Save(const std::string& path) const;
+
+  // Reads an index written by Save. It must have been built for this same
+  // graph; a file for a graph of another size, or a damaged one, is
+  // refused. Returns false if the file can't be read or is refused.
+  static bool Load(const std::string& path, const CsrGraph& graph,
+                   LandmarkIndex* index);
+
+  // The landmarks, as dense indices.
+  const std::vector<int32>& landmarks() const { return landmarks_; }
+
+  // A lower bound on the number of edges on a path from v to t (dense
+  // indices), or kNoPath if the tables prove there is none.
+  int32 LowerBound(int32 v, int32 t) const;
+
+  // Shortest path by A* with the landmark bounds. Same contract as
+  // CsrGraph::ShortestPath. graph must be the one the index was built for.
+  std::vector<int64> ShortestPath(const CsrGraph& graph, int64 from,
+                                  int64 to) const;
+
+ private:
+  int64 count_;
+  int64 edge_count_;
+  std::vector<int32> landmarks_;
+  // node major: the distances of node v are at [v * k, (v + 1) * k), so
+  // LowerBound reads one short run per node. -1 means unreachable.
+  // from_landmark_ holds d(L, v), to_landmark_ holds d(v, L).
+  std::vector<int32> from_landmark_;
+  std::vector<int32> to_landmark_;
+};
+
+#endif
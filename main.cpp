@@ -3,8 +3,35 @@
 #include<vector>
 #include<limits>
 #include<memory>
+#include<atomic>
+#include<thread>
+#include<fstream>
+#include<cstdio>
+#include<cstring>
+#include<cstddef>
+#include<cmath>
+#include<algorithm>
 #include "Catch-master/include/catch.hpp"
-#include "graph.hpp" 
+#include "graph.hpp"
+#include "csr_graph.hpp"
+#include "csr_snapshot.hpp"
+#include "bfs.hpp"
+#include "thread_pool.hpp"
+#include "edge_list.hpp"
+#include "reversed_view.hpp"
+#include "concurrent_graph.hpp"
+#include "mvcc_graph.hpp"
+#include "shortest_paths.hpp"
+#include "landmarks.hpp"
+#include "distance_index.hpp"
+#include "scc.hpp"
+#include "reachability.hpp"
+#include "union_find.hpp"
+#include "pagerank.hpp"
+#include "triangles.hpp"
+#include "kcore.hpp"
+#include "betweenness.hpp"
+#include "generators.hpp"
 
 TEST_CASE( "Doing operations on an empty graph", "[empty]" ) {
     std::unique_ptr<Graph> graph = std::make_unique<Graph>();
@@ -75,26 +102,1409 @@ TEST_CASE( "Testing add/delete", "[AddDelete]" ) {
     }
 }
 
-std::unique_ptr<Graph> make_graph(std::string filepath) {
+TEST_CASE( "checking shortest paths", "[shortestpath]" ) {
+  auto graph = LoadGraph("test1.txt", nullptr);
+  for(int i = 1; i < 6; ++i) {
+    REQUIRE( graph->IsConnected(i, i+1) );
+  }
+  REQUIRE( graph->ShortestPath(1,6).size() == 6);
+}
+
+
+TEST_CASE( "freezing a graph into a CSR snapshot", "[csr]" ) {
+  auto graph = LoadGraph("test1.txt", nullptr);
+  graph->AddNode(42);
+  graph->Connect(7, 1);
+  CsrGraph frozen = graph->Freeze();
+  REQUIRE( frozen.Count() == graph->Count() );
+  REQUIRE( frozen.EdgeCount() == 7 );
+  for(int i = 1; i < 7; ++i) {
+    REQUIRE( frozen.IsConnected(i, i+1) );
+    REQUIRE( !frozen.IsConnected(i+1, i) );
+  }
+  REQUIRE( frozen.ShortestPath(1, 7) == graph->ShortestPath(1, 7) );
+  REQUIRE( frozen.ShortestPath(5, 2).size() == 5 );
+  REQUIRE( frozen.ShortestPath(1, 42).empty() );
+  REQUIRE( frozen.ShortestPath(1, 100).empty() );
+  REQUIRE( frozen.ShortestPath(3, 3).size() == 1 );
+
+  SECTION( "the snapshot does not see later edits" ) {
+    graph->Delete(4);
+    REQUIRE( !graph->IsConnected(3, 4) );
+    REQUIRE( frozen.IsConnected(3, 4) );
+    CsrGraph refrozen = graph->Freeze();
+    REQUIRE( refrozen.Count() == frozen.Count() - 1 );
+    REQUIRE( refrozen.InNeighbors(refrozen.IndexOf(5)).size() == 0 );
+    REQUIRE( refrozen.ShortestPath(1, 7).empty() );
+  }
+}
+
+TEST_CASE( "the flat id map behaves like a map", "[flatidmap]" ) {
+  FlatIdMap<int64> map;
+  REQUIRE( map.empty() );
+  REQUIRE( map.Find(0) == nullptr );
+  // enough keys to force a few rehashes, including negative ones
+  for(int64 i = -500; i < 500; ++i) {
+    REQUIRE( map.Insert(i * 7, i) );
+  }
+  REQUIRE( map.size() == 1000 );
+  REQUIRE( !map.Insert(7, 0) );
+  REQUIRE( map.at(7) == 1 );
+  REQUIRE_THROWS( map.at(8) );
+  // erase every other key, the rest must still be reachable
+  for(int64 i = -500; i < 500; i += 2) {
+    REQUIRE( map.Erase(i * 7) );
+  }
+  REQUIRE( !map.Erase(-500 * 7) );
+  REQUIRE( map.size() == 500 );
+  for(int64 i = -499; i < 500; i += 2) {
+    REQUIRE( map.at(i * 7) == i );
+    REQUIRE( !map.Contains(i * 7 + 7) );
+  }
+  int64 seen = 0;
+  for(auto& kv : map) {
+    REQUIRE( kv.first == kv.second * 7 );
+    ++seen;
+  }
+  REQUIRE( seen == 500 );
+  std::vector<int64> keys = map.SortedKeys();
+  REQUIRE( std::is_sorted(keys.begin(), keys.end()) );
+  REQUIRE( keys.front() == -499 * 7 );
+  map[3] += 5;
+  REQUIRE( map.at(3) == 5 );
+}
+
+TEST_CASE( "adjacency sets keep set semantics across representations", "[adjacency]" ) {
+  // a tiny hash threshold so we go inline -> sorted -> hashed and back
+  const int64 threshold = 8;
+  Adjacency adjacency;
+  REQUIRE( adjacency.empty() );
+  for(int64 i = 20; i > 0; --i) {
+    REQUIRE( adjacency.Insert(i * 3, threshold) );
+    REQUIRE( !adjacency.Insert(i * 3, threshold) );
+    REQUIRE( adjacency.size() == 21 - i );
+  }
+  for(int64 i = 1; i <= 20; ++i) {
+    REQUIRE( adjacency.Contains(i * 3) );
+    REQUIRE( !adjacency.Contains(i * 3 + 1) );
+  }
+  Adjacency copy = adjacency;
+  for(int64 i = 1; i <= 19; ++i) {
+    REQUIRE( adjacency.Erase(i * 3) );
+    REQUIRE( !adjacency.Erase(i * 3) );
+  }
+  REQUIRE( adjacency.size() == 1 );
+  REQUIRE( adjacency.Contains(60) );
+  REQUIRE( copy.size() == 20 );
+  std::vector<int64> ids;
+  copy.ForEach([&](int64 id) { ids.push_back(id); });
+  std::sort(ids.begin(), ids.end());
+  REQUIRE( ids.size() == 20 );
+  REQUIRE( ids.front() == 3 );
+  REQUIRE( ids.back() == 60 );
+
+  SECTION( "a graph with hubs above the threshold" ) {
+    Graph graph(threshold);
+    int64 hub = graph.AddNode(1000);
+    for(int64 i = 0; i < 50; ++i) {
+      graph.AddNode(i);
+      graph.Connect(hub, i);
+      graph.Connect(i, hub);
+    }
+    REQUIRE( graph.IsConnected(hub, 49) );
+    REQUIRE( graph.ShortestPath(3, 7).size() == 3 );
+    Graph reversed = graph.DeepCopy();
+    Graph::Reverse(&reversed);
+    graph.Disconnect(hub, 7);
+    REQUIRE( graph.ShortestPath(3, 7).empty() );
+    REQUIRE( reversed.ShortestPath(3, 7).size() == 3 );
+    graph.Delete(hub);
+    REQUIRE( graph.Count() == 50 );
+    REQUIRE( graph.Freeze().EdgeCount() == 0 );
+  }
+}
+
+// plain one-sided BFS on the snapshot, to check the fancier searches against
+int64 reference_distance(const CsrGraph& graph, int64 from, int64 to) {
+  std::vector<int64> distance(graph.Count(), -1);
+  std::vector<int32> queue(1, graph.IndexOf(from));
+  distance[queue[0]] = 0;
+  for(size_t head = 0; head < queue.size(); ++head) {
+    for(int32 v : graph.OutNeighbors(queue[head])) {
+      if(distance[v] == -1) {
+        distance[v] = distance[queue[head]] + 1;
+        queue.push_back(v);
+      }
+    }
+  }
+  return distance[graph.IndexOf(to)];
+}
+
+// a fixed pseudo random graph, so the tests are reproducible
+std::unique_ptr<Graph> make_random_graph(int64 nodes, int64 edges,
+                                         unsigned int seed) {
   std::unique_ptr<Graph> result = std::make_unique<Graph>();
-  std::ifstream input_file;
-  input_file.open(filepath);
-  int m;
-  input_file >> m;
-  for(int i = 0; i < m; ++i) {
-    int64 from, to;
-    input_file >> from >> to;
-    result->AddNode(from); result->AddNode(to);
+  for(int64 i = 0; i < nodes; ++i) result->AddNode(i);
+  uint64_t state = seed;
+  for(int64 i = 0; i < edges; ++i) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    int64 from = (state >> 33) % nodes;
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    int64 to = (state >> 33) % nodes;
     result->Connect(from, to);
   }
   return result;
 }
 
-TEST_CASE( "checking shortest paths", "[shortestpath]" ) {
-  auto graph = make_graph("test1.txt");
-  for(int i = 1; i < 6; ++i) {
-    REQUIRE( graph->IsConnected(i, i+1) );
+TEST_CASE( "bidirectional shortest paths are shortest", "[shortestpath]" ) {
+  auto graph = make_random_graph(300, 600, 7);
+  CsrGraph frozen = graph->Freeze();
+  for(int64 from = 0; from < 300; from += 13) {
+    for(int64 to = 0; to < 300; to += 11) {
+      std::vector<int64> path = graph->ShortestPath(from, to);
+      int64 expected = reference_distance(frozen, from, to);
+      REQUIRE( static_cast<int64>(path.size()) == expected + 1 );
+      REQUIRE( frozen.ShortestPath(from, to).size() == path.size() );
+      if(path.empty()) continue;
+      REQUIRE( path.front() == from );
+      REQUIRE( path.back() == to );
+      for(size_t i = 0; i + 1 < path.size(); ++i) {
+        REQUIRE( graph->IsConnected(path[i], path[i + 1]) );
+      }
+    }
   }
-  REQUIRE( graph->ShortestPath(1,6).size() == 6);
 }
 
+TEST_CASE( "direction optimizing BFS matches plain BFS", "[bfs]" ) {
+  // sparse enough to stay top-down, and dense enough to go bottom-up
+  int64 edge_counts[] = {400, 6000};
+  for(int64 edges : edge_counts) {
+    CsrGraph frozen = make_random_graph(300, edges, 11)->Freeze();
+    for(int64 from = 0; from < 300; from += 37) {
+      BfsTree tree = DirectionOptimizingBfs(frozen, frozen.IndexOf(from));
+      std::vector<int64> reachable = ReachableFrom(frozen, from);
+      int64 reached = 0;
+      for(int64 to = 0; to < 300; ++to) {
+        int32 index = frozen.IndexOf(to);
+        int64 expected = reference_distance(frozen, from, to);
+        REQUIRE( tree.distance[index] == expected );
+        if(expected == -1) continue;
+        ++reached;
+        std::vector<int64> path = PathTo(frozen, tree, index);
+        REQUIRE( static_cast<int64>(path.size()) == expected + 1 );
+        for(size_t i = 0; i + 1 < path.size(); ++i) {
+          REQUIRE( frozen.IsConnected(path[i], path[i + 1]) );
+        }
+      }
+      REQUIRE( static_cast<int64>(reachable.size()) == reached );
+    }
+  }
+  REQUIRE( ReachableFrom(CsrGraph(), 1).empty() );
+}
+
+TEST_CASE( "parallel BFS gives the same distances", "[bfs]" ) {
+  ThreadPool pool(4);
+  REQUIRE( pool.size() == 4 );
+  std::atomic<int64> sum(0);
+  pool.ParallelFor(1000, 7, [&](int thread, int64 begin, int64 end) {
+    for(int64 i = begin; i < end; ++i) sum += i;
+  });
+  REQUIRE( sum == 999 * 1000 / 2 );
+
+  CsrGraph frozen = make_random_graph(2000, 8000, 5)->Freeze();
+  for(int64 from = 0; from < 2000; from += 401) {
+    int32 source = frozen.IndexOf(from);
+    BfsTree expected = DirectionOptimizingBfs(frozen, source);
+    BfsTree tree = ParallelBfs(frozen, source, &pool);
+    REQUIRE( tree.distance == expected.distance );
+    REQUIRE( ParallelBfs(frozen, source, nullptr).distance ==
+             expected.distance );
+    for(int32 v = 0; v < frozen.Count(); ++v) {
+      if(tree.distance[v] <= 0) continue;
+      REQUIRE( frozen.IsConnected(frozen.IdOf(tree.parent[v]), frozen.IdOf(v)) );
+      REQUIRE( tree.distance[tree.parent[v]] == tree.distance[v] - 1 );
+    }
+  }
+}
+
+TEST_CASE( "batched shortest paths answer every query", "[bfs]" ) {
+  auto graph = make_random_graph(500, 1200, 3);
+  CsrGraph frozen = graph->Freeze();
+  // more than one batch worth of sources, some repeated, some missing
+  std::vector<std::pair<int64, int64>> queries;
+  for(int64 i = 0; i < 150; ++i) {
+    queries.push_back(std::make_pair((i * 7) % 97, (i * 31) % 500));
+  }
+  queries.push_back(std::make_pair(5, 5));
+  queries.push_back(std::make_pair(-1, 5));
+  queries.push_back(std::make_pair(5, 1000));
+  std::vector<std::vector<int64>> paths = BatchShortestPaths(frozen, queries);
+  REQUIRE( paths.size() == queries.size() );
+  for(size_t q = 0; q < queries.size(); ++q) {
+    std::vector<int64>& path = paths[q];
+    REQUIRE( path.size() == graph->ShortestPath(queries[q].first,
+                                                queries[q].second).size() );
+    if(path.empty()) continue;
+    REQUIRE( path.front() == queries[q].first );
+    REQUIRE( path.back() == queries[q].second );
+    for(size_t i = 0; i + 1 < path.size(); ++i) {
+      REQUIRE( graph->IsConnected(path[i], path[i + 1]) );
+    }
+  }
+  REQUIRE( paths[150].size() == 1 );
+  REQUIRE( paths[151].empty() );
+  REQUIRE( paths[152].empty() );
+}
+
+TEST_CASE( "loading edge lists", "[loader]" ) {
+  std::vector<std::pair<int64, int64>> edges;
+  REQUIRE( !ReadEdgeList("no_such_file.txt", nullptr, &edges) );
+  REQUIRE( LoadGraph("no_such_file.txt", nullptr) == nullptr );
+  REQUIRE( ReadEdgeList("test1.txt", nullptr, &edges) );
+  REQUIRE( edges.size() == 6 );
+  REQUIRE( edges[5] == std::make_pair(6LL, 7LL) );
+
+  // big enough to be cut into several chunks, with a few odd lines
+  const char* path = "edge_list_test.txt";
+  {
+    std::ofstream out(path);
+    out << 30000 << "\n";
+    for(int64 i = 0; i < 30000; ++i) {
+      out << (i % 1000) - 500 << " " << (i * 7919) % 1000 << "\n";
+    }
+    // past the edge count, must be ignored
+    out << "1 2\n3 4\n";
+  }
+  ThreadPool pool(4);
+  REQUIRE( ReadEdgeList(path, &pool, &edges) );
+  REQUIRE( edges.size() == 30000 );
+  for(int64 i = 0; i < 30000; ++i) {
+    REQUIRE( edges[i].first == (i % 1000) - 500 );
+    REQUIRE( edges[i].second == (i * 7919) % 1000 );
+  }
+  auto graph = LoadGraph(path, &pool);
+  CsrGraph frozen;
+  REQUIRE( LoadCsrGraph(path, &pool, &frozen) );
+
+  SECTION( "the ends of the int64 range and numbers past them" ) {
+    {
+      std::ofstream out(path);
+      out << "2\n-9223372036854775808 9223372036854775807\n"
+          << "9223372036854775807 -9223372036854775807\n";
+    }
+    std::vector<std::pair<int64, int64>> extremes;
+    REQUIRE( ReadEdgeList(path, nullptr, &extremes) );
+    REQUIRE( extremes.size() == 2 );
+    REQUIRE( extremes[0].first == std::numeric_limits<int64>::min() );
+    REQUIRE( extremes[0].second == std::numeric_limits<int64>::max() );
+    REQUIRE( extremes[1].second == -std::numeric_limits<int64>::max() );
+    {
+      std::ofstream out(path);
+      out << "2\n\n1 2\r\n\n3 4";
+    }
+    REQUIRE( ReadEdgeList(path, &pool, &extremes) );
+    REQUIRE( extremes.size() == 2 );
+    REQUIRE( extremes[1] == std::make_pair(3LL, 4LL) );
+    const char* malformed[] = {
+      "1\n9223372036854775808 1\n",
+      "1\n-9223372036854775809 1\n",
+      "1\n1 123456789012345678901\n",
+      "1\n1 - 2\n",
+      "1\n3 -\n",
+      "99999999999999999999\n1 2\n",
+      // a dangling endpoint, alone or after a whole edge
+      "2\n1 2\n3\n",
+      "2\n1 2\n3 4 5\n",
+      "1\n1 2 3"};
+    for(const char* contents : malformed) {
+      {
+        std::ofstream out(path);
+        out << contents;
+      }
+      REQUIRE( !ReadEdgeList(path, &pool, &extremes) );
+      REQUIRE( LoadGraph(path, nullptr) == nullptr );
+    }
+  }
+  std::remove(path);
+  REQUIRE( frozen.Count() == graph->Count() );
+  CsrGraph expected = graph->Freeze();
+  REQUIRE( frozen.EdgeCount() == expected.EdgeCount() );
+  for(int32 i = 0; i < frozen.Count(); ++i) {
+    REQUIRE( frozen.IdOf(i) == expected.IdOf(i) );
+    REQUIRE( std::vector<int32>(frozen.OutNeighbors(i).begin(),
+                                frozen.OutNeighbors(i).end()) ==
+             std::vector<int32>(expected.OutNeighbors(i).begin(),
+                                expected.OutNeighbors(i).end()) );
+    REQUIRE( std::vector<int32>(frozen.InNeighbors(i).begin(),
+                                frozen.InNeighbors(i).end()) ==
+             std::vector<int32>(expected.InNeighbors(i).begin(),
+                                expected.InNeighbors(i).end()) );
+  }
+}
+
+TEST_CASE( "binary snapshots round trip", "[snapshot]" ) {
+  auto graph = make_random_graph(400, 1500, 13);
+  graph->AddNode(-77);
+  graph->Connect(-77, 3);
+  CsrGraph frozen = graph->Freeze();
+  const char* path = "snapshot_test.bin";
+  bool with_incoming_options[] = {true, false};
+  for(bool with_incoming : with_incoming_options) {
+    REQUIRE( frozen.WriteSnapshot(path, with_incoming) );
+    bool verify_options[] = {true, false};
+    for(bool verify : verify_options) {
+      CsrGraph opened;
+      REQUIRE( CsrGraph::OpenSnapshot(path, verify, &opened) );
+      REQUIRE( opened.Count() == frozen.Count() );
+      REQUIRE( opened.EdgeCount() == frozen.EdgeCount() );
+      REQUIRE( opened.IsConnected(-77, 3) );
+      for(int32 i = 0; i < frozen.Count(); ++i) {
+        REQUIRE( opened.IdOf(i) == frozen.IdOf(i) );
+        REQUIRE( opened.OutDegree(i) == frozen.OutDegree(i) );
+        REQUIRE( opened.InDegree(i) == frozen.InDegree(i) );
+      }
+      for(int64 from = 0; from < 400; from += 57) {
+        REQUIRE( opened.ShortestPath(from, 399) ==
+                 frozen.ShortestPath(from, 399) );
+      }
+    }
+  }
+  CsrGraph opened;
+  REQUIRE( !CsrGraph::OpenSnapshot("no_such_file.bin", true, &opened) );
+  REQUIRE( !CsrGraph::OpenSnapshot("test1.txt", false, &opened) );
+
+  SECTION( "weights come back too" ) {
+    Graph weighted;
+    for(int64 i = 0; i < 50; ++i) weighted.AddNode(i);
+    for(int64 i = 0; i < 200; ++i) {
+      weighted.Connect((i * 7) % 50, (i * 13 + 1) % 50, 0.5 + (i % 9));
+    }
+    CsrGraph heavy = weighted.Freeze();
+    for(bool with_incoming : with_incoming_options) {
+      REQUIRE( heavy.WriteSnapshot(path, with_incoming) );
+      REQUIRE( CsrGraph::OpenSnapshot(path, true, &opened) );
+      REQUIRE( opened.IsWeighted() );
+      for(int32 i = 0; i < heavy.Count(); ++i) {
+        for(int64 e = 0; e < heavy.OutDegree(i); ++e) {
+          REQUIRE( opened.OutWeights(i)[e] == heavy.OutWeights(i)[e] );
+        }
+        for(int64 e = 0; e < heavy.InDegree(i); ++e) {
+          REQUIRE( opened.InWeights(i)[e] == heavy.InWeights(i)[e] );
+        }
+      }
+      for(int64 to = 0; to < 50; to += 3) {
+        REQUIRE( opened.WeightedShortestPath(0, to) ==
+                 heavy.WeightedShortestPath(0, to) );
+      }
+    }
+    // and an unweighted one stays unweighted
+    REQUIRE( frozen.WriteSnapshot(path, true) );
+    REQUIRE( CsrGraph::OpenSnapshot(path, true, &opened) );
+    REQUIRE( !opened.IsWeighted() );
+  }
+  SECTION( "corruption is caught when verifying" ) {
+    REQUIRE( frozen.WriteSnapshot(path, true) );
+    {
+      std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+      file.seekp(-3, std::ios::end);
+      file.put('\x7f');
+    }
+    REQUIRE( !CsrGraph::OpenSnapshot(path, true, &opened) );
+  }
+  SECTION( "so is truncation, even without verifying" ) {
+    REQUIRE( frozen.WriteSnapshot(path, true) );
+    std::string contents;
+    {
+      std::ifstream in(path, std::ios::binary);
+      contents.assign(std::istreambuf_iterator<char>(in),
+                      std::istreambuf_iterator<char>());
+    }
+    {
+      std::ofstream out(path, std::ios::binary | std::ios::trunc);
+      out.write(contents.data(), contents.size() - 100);
+    }
+    REQUIRE( !CsrGraph::OpenSnapshot(path, false, &opened) );
+  }
+  SECTION( "and sizes that would wrap around, even if consistent" ) {
+    REQUIRE( frozen.WriteSnapshot(path, true) );
+    int64 huge[] = {int64(1) << 62, int64(1) << 61};
+    for(int64 edge_count : huge) {
+      std::string contents;
+      {
+        std::ifstream in(path, std::ios::binary);
+        contents.assign(std::istreambuf_iterator<char>(in),
+                        std::istreambuf_iterator<char>());
+      }
+      // 2^62 four byte targets take 0 bytes after wrapping around; make
+      // the sections, the last offsets and all the checksums agree
+      SnapshotHeader header;
+      std::memcpy(&header, contents.data(), sizeof(header));
+      header.edge_count = edge_count;
+      SnapshotSectionId targets[] = {kSectionOutTargets, kSectionInTargets};
+      for(SnapshotSectionId s : targets) {
+        SnapshotSection& section = header.sections[s];
+        section.bytes = static_cast<uint64_t>(edge_count) * 4;
+        if(section.bytes <= contents.size() - section.offset) {
+          section.checksum = SnapshotChecksum(&contents[section.offset],
+                                              section.bytes);
+        }
+      }
+      SnapshotSectionId offsets[] = {kSectionOutOffsets, kSectionInOffsets};
+      for(SnapshotSectionId s : offsets) {
+        SnapshotSection& section = header.sections[s];
+        std::memcpy(&contents[section.offset + section.bytes - 8],
+                    &edge_count, 8);
+        section.checksum = SnapshotChecksum(&contents[section.offset],
+                                            section.bytes);
+      }
+      header.header_checksum = SnapshotChecksum(
+        reinterpret_cast<const char*>(&header),
+        offsetof(SnapshotHeader, header_checksum));
+      std::memcpy(&contents[0], &header, sizeof(header));
+      {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(contents.data(), contents.size());
+      }
+      REQUIRE( !CsrGraph::OpenSnapshot(path, true, &opened) );
+      REQUIRE( !CsrGraph::OpenSnapshot(path, false, &opened) );
+    }
+  }
+  std::remove(path);
+}
+
+TEST_CASE( "batch connects match one at a time connects", "[batch]" ) {
+  // a small threshold, so batches also land in hashed edge sets
+  Graph one_by_one(16);
+  Graph batched(16);
+  Graph parallel(16);
+  std::vector<std::pair<int64, int64>> edges;
+  for(int64 i = 0; i < 3000; ++i) {
+    // lots of repeats, and a few hubs
+    int64 from = (i * 37) % 200;
+    int64 to = i % 7 == 0 ? 5 : (i * 101) % 250;
+    edges.push_back(std::make_pair(from, to));
+  }
+  // an edge to a node that is not there yet must wait for it
+  for(int64 i = 0; i < 200; ++i) one_by_one.AddNode(i);
+  for(int64 i = 0; i < 200; ++i) batched.AddNode(i);
+  for(auto& edge : edges) one_by_one.Connect(edge.first, edge.second);
+  batched.ConnectBatch(edges, nullptr);
+  REQUIRE( batched.Count() == 200 );
+  for(auto& edge : edges) one_by_one.AddNode(edge.second);
+  for(auto& edge : edges) one_by_one.Connect(edge.first, edge.second);
+  batched.AddAndConnectBatch(edges, nullptr);
+  ThreadPool pool(4);
+  parallel.AddAndConnectBatch(edges, &pool);
+  // second batch on top of the first
+  parallel.AddAndConnectBatch(edges, &pool);
+
+  CsrGraph expected = one_by_one.Freeze();
+  CsrGraph graphs[] = {batched.Freeze(), parallel.Freeze()};
+  for(CsrGraph& frozen : graphs) {
+    REQUIRE( frozen.Count() == expected.Count() );
+    REQUIRE( frozen.EdgeCount() == expected.EdgeCount() );
+    for(int32 i = 0; i < frozen.Count(); ++i) {
+      REQUIRE( frozen.IdOf(i) == expected.IdOf(i) );
+      REQUIRE( frozen.OutDegree(i) == expected.OutDegree(i) );
+      REQUIRE( frozen.InDegree(i) == expected.InDegree(i) );
+    }
+  }
+  for(auto& edge : edges) {
+    REQUIRE( parallel.IsConnected(edge.first, edge.second) );
+  }
+}
+
+TEST_CASE( "copy on write copies behave like deep copies", "[cow]" ) {
+  auto graph = LoadGraph("test1.txt", nullptr);
+  Graph copy = graph->CowCopy();
+  REQUIRE( copy.Count() == 7 );
+  REQUIRE( copy.ShortestPath(1, 7).size() == 7 );
+  // edits on either side stay on that side
+  copy.Disconnect(3, 4);
+  copy.Connect(7, 1);
+  REQUIRE( !copy.IsConnected(3, 4) );
+  REQUIRE( graph->IsConnected(3, 4) );
+  REQUIRE( !graph->IsConnected(7, 1) );
+  REQUIRE( graph->ShortestPath(7, 1).empty() );
+  REQUIRE( copy.ShortestPath(7, 2).size() == 3 );
+  graph->Delete(5);
+  REQUIRE( copy.IsConnected(4, 5) );
+  REQUIRE( copy.IsConnected(5, 6) );
+  REQUIRE( !graph->IsConnected(4, 5) );
+
+  SECTION( "copies of copies, and reversing one of them" ) {
+    Graph second = copy.CowCopy();
+    Graph::Reverse(&second);
+    REQUIRE( second.IsConnected(1, 7) );
+    REQUIRE( copy.IsConnected(7, 1) );
+    REQUIRE( !copy.IsConnected(1, 7) );
+    second.Delete(1);
+    REQUIRE( copy.IsConnected(7, 1) );
+    REQUIRE( copy.IsConnected(1, 2) );
+    REQUIRE( second.Count() == 6 );
+    REQUIRE( copy.Count() == 7 );
+  }
+  SECTION( "a self loop on a shared node" ) {
+    copy.Connect(2, 2);
+    Graph second = copy.CowCopy();
+    second.Delete(2);
+    REQUIRE( copy.IsConnected(2, 2) );
+    REQUIRE( copy.IsConnected(1, 2) );
+    REQUIRE( !second.IsConnected(1, 2) );
+  }
+}
+
+TEST_CASE( "reversed views answer like a reversed copy", "[reverse]" ) {
+  auto graph = make_random_graph(200, 500, 17);
+  Graph reversed = graph->DeepCopy();
+  Graph::Reverse(&reversed);
+  ReversedView view(graph.get());
+  CsrGraph frozen_reversed = graph->Freeze().Reversed();
+  REQUIRE( view.Count() == reversed.Count() );
+  for(int64 a = 0; a < 200; a += 7) {
+    for(int64 b = 0; b < 200; b += 3) {
+      REQUIRE( view.IsConnected(a, b) == reversed.IsConnected(a, b) );
+      REQUIRE( frozen_reversed.IsConnected(a, b) == reversed.IsConnected(a, b) );
+      std::vector<int64> path = view.ShortestPath(a, b);
+      REQUIRE( path.size() == reversed.ShortestPath(a, b).size() );
+      REQUIRE( frozen_reversed.ShortestPath(a, b).size() == path.size() );
+      for(size_t i = 0; i + 1 < path.size(); ++i) {
+        REQUIRE( reversed.IsConnected(path[i], path[i + 1]) );
+      }
+    }
+    std::vector<int64> from_view, from_copy;
+    view.ForEachSuccessor(a, [&](int64 v) { from_view.push_back(v); });
+    reversed.ForEachSuccessor(a, [&](int64 v) { from_copy.push_back(v); });
+    std::sort(from_view.begin(), from_view.end());
+    std::sort(from_copy.begin(), from_copy.end());
+    REQUIRE( from_view == from_copy );
+  }
+  // the view follows the graph
+  graph->Connect(150, 3);
+  REQUIRE( view.IsConnected(3, 150) );
+}
+
+TEST_CASE( "concurrent graph survives many writers and readers", "[concurrent]" ) {
+  ConcurrentGraph graph(8);
+  const int64 kNodes = 400;
+  for(int64 i = 0; i < kNodes; ++i) graph.AddNode(i);
+  auto empty = graph.Snapshot();
+  REQUIRE( empty->Count() == kNodes );
+  REQUIRE( graph.Snapshot() == empty );
+  // every thread owns the edges out of its own nodes, so the end result is
+  // known no matter how the threads interleave
+  const int kThreads = 4;
+  std::vector<std::thread> threads;
+  std::atomic<int> ready(0);
+  for(int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&graph, &ready, t, kNodes]() {
+      ++ready;
+      for(int64 from = t; from < kNodes; from += kThreads) {
+        graph.Connect(from, (from + 1) % kNodes);
+        graph.Connect(from, (from * 7 + 3) % kNodes);
+        graph.Connect(from, (from + 2) % kNodes);
+        graph.Disconnect(from, (from + 2) % kNodes);
+      }
+    });
+  }
+  // reads race the writes, they just have to give sane answers
+  while(ready < kThreads) {}
+  for(int i = 0; i < 50; ++i) {
+    auto snapshot = graph.Snapshot();
+    REQUIRE( snapshot->Count() == kNodes );
+    std::vector<int64> path = graph.ShortestPath(0, kNodes - 1);
+    for(size_t p = 0; p + 1 < path.size(); ++p) {
+      REQUIRE( (path[p + 1] == (path[p] + 1) % kNodes ||
+                path[p + 1] == (path[p] * 7 + 3) % kNodes ||
+                path[p + 1] == (path[p] + 2) % kNodes) );
+    }
+  }
+  for(auto& thread : threads) thread.join();
+
+  Graph expected;
+  for(int64 i = 0; i < kNodes; ++i) expected.AddNode(i);
+  for(int64 from = 0; from < kNodes; ++from) {
+    expected.Connect(from, (from + 1) % kNodes);
+    expected.Connect(from, (from * 7 + 3) % kNodes);
+  }
+  auto snapshot = graph.Snapshot();
+  REQUIRE( snapshot->EdgeCount() == expected.Freeze().EdgeCount() );
+  for(int64 a = 0; a < kNodes; a += 13) {
+    for(int64 b = 0; b < kNodes; b += 11) {
+      size_t length = expected.ShortestPath(a, b).size();
+      REQUIRE( graph.ShortestPath(a, b).size() == length );
+      REQUIRE( snapshot->ShortestPath(a, b).size() == length );
+    }
+  }
+  // deleting a node takes its edges in both directions with it
+  graph.Delete(1);
+  REQUIRE( !graph.Contains(1) );
+  REQUIRE( !graph.IsConnected(0, 1) );
+  REQUIRE( graph.Count() == kNodes - 1 );
+  REQUIRE( graph.Snapshot() != snapshot );
+  REQUIRE( graph.Snapshot()->Count() == kNodes - 1 );
+  int64 fresh = graph.AddNode();
+  REQUIRE( graph.Contains(fresh) );
+  REQUIRE( graph.Count() == kNodes );
+}
+
+TEST_CASE( "mvcc readers see whole commits and keep their version", "[mvcc]" ) {
+  MvccGraph graph;
+  for(int64 i = 0; i < 100; ++i) graph.AddNode(i);
+  graph.Connect(0, 1);
+  MvccGraph::ReadView before = graph.Read();
+  graph.Connect(1, 2);
+  graph.Delete(0);
+  // the old view is exactly as it was when it was pinned
+  REQUIRE( before.Count() == 100 );
+  REQUIRE( before.IsConnected(0, 1) );
+  REQUIRE( !before.IsConnected(1, 2) );
+  REQUIRE( before.ShortestPath(0, 2).empty() );
+  {
+    MvccGraph::ReadView after = graph.Read();
+    REQUIRE( after.Count() == 99 );
+    REQUIRE( !after.Contains(0) );
+    REQUIRE( after.IsConnected(1, 2) );
+    REQUIRE( after.ShortestPath(1, 2).size() == 2 );
+  }
+  REQUIRE( graph.AddNode() == 0 );
+
+  // a writer keeps committing batches that each add an edge both ways,
+  // readers must never see one direction without the other
+  std::atomic<bool> done(false);
+  std::thread writer([&graph, &done]() {
+    for(int64 round = 0; round < 300; ++round) {
+      MvccGraph::WriteBatch batch;
+      int64 a = round % 100, b = (round * 37 + 11) % 100;
+      if(round % 3 == 2) {
+        batch.Disconnect(a, b);
+        batch.Disconnect(b, a);
+      } else {
+        batch.Connect(a, b);
+        batch.Connect(b, a);
+      }
+      graph.Commit(batch);
+    }
+    done = true;
+  });
+  std::vector<std::thread> readers;
+  std::atomic<int> torn(0);
+  for(int t = 0; t < 3; ++t) {
+    readers.emplace_back([&graph, &done, &torn, t]() {
+      int64 round = t;
+      do {
+        MvccGraph::ReadView view = graph.Read();
+        for(int64 i = 0; i < 50; ++i, ++round) {
+          int64 a = round % 100, b = (round * 37 + 11) % 100;
+          if(view.IsConnected(a, b) != view.IsConnected(b, a)) ++torn;
+        }
+        std::vector<int64> there = view.ShortestPath(2, 40);
+        std::vector<int64> back = view.ShortestPath(40, 2);
+        if(there.size() != back.size()) ++torn;
+      } while(!done);
+    });
+  }
+  writer.join();
+  for(auto& reader : readers) reader.join();
+  REQUIRE( torn == 0 );
+  REQUIRE( before.Count() == 100 );
+}
+
+TEST_CASE( "mvcc commits cost the same on small and big graphs", "[mvcc]" ) {
+  // what a one edge commit copies, on a graph of n nodes in a ring
+  auto commit_cost = [](int64 n) {
+    MvccGraph graph;
+    for(int64 start = 0; start < n; start += 5000) {
+      MvccGraph::WriteBatch batch;
+      for(int64 i = start; i < std::min(n, start + 5000); ++i) {
+        batch.AddNode(i);
+        if(i > 0) batch.Connect(i - 1, i);
+      }
+      graph.Commit(batch);
+    }
+    graph.Connect(n - 1, 0);
+    int64 copied = graph.LastCommitCopied();
+    // growing the trie along the way lost nothing
+    MvccGraph::ReadView view = graph.Read();
+    REQUIRE( view.Count() == n );
+    for(int64 i = 0; i < n; i += n / 100) {
+      REQUIRE( view.IsConnected(i, (i + 1) % n) );
+    }
+    return copied;
+  };
+  int64 small = commit_cost(1000);
+  int64 big = commit_cost(300000);
+  REQUIRE( small > 0 );
+  // one chunk per end of the edge and the paths down to them, so the big
+  // graph only pays for a deeper trie. 300000 / 256 fixed chunks would
+  // have meant over a thousand entries per chunk.
+  REQUIRE( big < 4 * small );
+  REQUIRE( big < 1000 );
+
+  // a view pinned before the trie grows still reads the old shape
+  MvccGraph graph;
+  graph.AddNode(0);
+  MvccGraph::ReadView before = graph.Read();
+  MvccGraph::WriteBatch batch;
+  for(int64 i = 1; i < 20000; ++i) batch.AddNode(i);
+  graph.Commit(batch);
+  REQUIRE( before.Count() == 1 );
+  REQUIRE( before.Contains(0) );
+  REQUIRE( !before.Contains(1) );
+  REQUIRE( graph.Read().Count() == 20000 );
+}
+
+TEST_CASE( "weighted shortest paths agree everywhere", "[weighted]" ) {
+  auto graph = make_random_graph(300, 1200, 23);
+  // give most edges a weight, some stay at the default 1
+  uint64_t state = 99;
+  for(int64 u = 0; u < 300; ++u) {
+    std::vector<int64> targets;
+    graph->ForEachSuccessor(u, [&](int64 v) { targets.push_back(v); });
+    for(int64 v : targets) {
+      state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+      if(state >> 62 == 0) continue;
+      graph->Connect(u, v, 0.5 + (state >> 33) % 100 / 10.0);
+    }
+  }
+  CsrGraph frozen = graph->Freeze();
+  REQUIRE( frozen.IsWeighted() );
+  REQUIRE( !make_random_graph(10, 20, 1)->Freeze().IsWeighted() );
+  ThreadPool pool(4);
+  auto total = [&](const std::vector<int64>& path) {
+    double sum = 0;
+    for(size_t i = 0; i + 1 < path.size(); ++i) {
+      sum += graph->Weight(path[i], path[i + 1]);
+    }
+    return sum;
+  };
+  for(int64 from = 0; from < 300; from += 37) {
+    int32 source = frozen.IndexOf(from);
+    WeightedTree tree = Dijkstra(frozen, source);
+    // odd deltas and no pool too, they must not change the answer
+    double deltas[] = {3.0, 1e-300, 0.0, -1.0,
+                       std::numeric_limits<double>::infinity(),
+                       std::numeric_limits<double>::quiet_NaN()};
+    for(double delta : deltas) {
+      std::vector<double> stepped = DeltaStepping(
+        frozen, source, delta, delta == 3.0 ? &pool : nullptr);
+      for(int32 v = 0; v < frozen.Count(); ++v) {
+        if(tree.distance[v] == std::numeric_limits<double>::infinity()) {
+          REQUIRE( stepped[v] == tree.distance[v] );
+        } else {
+          REQUIRE( stepped[v] == Approx(tree.distance[v]) );
+        }
+      }
+    }
+    for(int64 to = 0; to < 300; to += 7) {
+      int32 target = frozen.IndexOf(to);
+      std::vector<int64> path = graph->WeightedShortestPath(from, to);
+      std::vector<int64> frozen_path = frozen.WeightedShortestPath(from, to);
+      if(tree.distance[target] == std::numeric_limits<double>::infinity()) {
+        REQUIRE( path.empty() );
+        REQUIRE( frozen_path.empty() );
+        continue;
+      }
+      REQUIRE( path.front() == from );
+      REQUIRE( path.back() == to );
+      REQUIRE( total(path) == Approx(tree.distance[target]) );
+      REQUIRE( total(frozen_path) == Approx(tree.distance[target]) );
+    }
+  }
+  // the reversed snapshot carries the weights along
+  CsrGraph reversed = frozen.Reversed();
+  REQUIRE( reversed.Weight(5, 3) == frozen.Weight(3, 5) );
+
+  // weights follow the edges through edits and copies
+  Graph small;
+  for(int64 i = 0; i < 4; ++i) small.AddNode(i);
+  small.Connect(0, 1, 2.5);
+  small.Connect(0, 2);
+  REQUIRE( small.Weight(0, 1) == 2.5 );
+  REQUIRE( small.Weight(0, 2) == 1.0 );
+  REQUIRE( small.Weight(0, 3) == std::numeric_limits<double>::infinity() );
+  small.ConnectBatch({{0, 3}}, nullptr);
+  REQUIRE( small.Weight(0, 3) == 1.0 );
+  Graph copy = small.CowCopy();
+  copy.Connect(0, 1, 7.0);
+  REQUIRE( small.Weight(0, 1) == 2.5 );
+  REQUIRE( small.DeepCopy().Weight(0, 1) == 2.5 );
+  small.Disconnect(0, 1);
+  small.Connect(0, 1);
+  REQUIRE( small.Weight(0, 1) == 1.0 );
+  Graph::Reverse(&copy);
+  REQUIRE( copy.Weight(1, 0) == 7.0 );
+  REQUIRE( copy.Weight(3, 0) == 1.0 );
+  copy.Delete(1);
+  REQUIRE( copy.Weight(1, 0) == std::numeric_limits<double>::infinity() );
+  REQUIRE( copy.Freeze().Weight(2, 0) == 1.0 );
+
+  // negative and NaN weights are refused and leave the graph alone
+  small.Connect(2, 3, -1.0);
+  small.Connect(2, 1, std::numeric_limits<double>::quiet_NaN());
+  small.Connect(0, 2, -0.5);
+  REQUIRE( !small.Freeze().IsConnected(2, 3) );
+  REQUIRE( small.Weight(2, 1) == std::numeric_limits<double>::infinity() );
+  REQUIRE( small.Weight(0, 2) == 1.0 );
+  small.Connect(2, 3, 0.0);
+  REQUIRE( small.Weight(2, 3) == 0.0 );
+
+  // a hub with weighted edges in random order, some set back to 1
+  Graph hub;
+  for(int64 i = 0; i < 20000; ++i) hub.AddNode(i);
+  for(int64 i = 1; i < 20000; ++i) {
+    int64 to = (i * 7919) % 19999 + 1;
+    hub.Connect(0, to, to % 3 == 0 ? 1.0 : to * 0.5);
+  }
+  for(int64 to = 1; to < 20000; to += 5) hub.Connect(0, to, 1.0);
+  CsrGraph frozen_hub = hub.Freeze();
+  REQUIRE( frozen_hub.OutDegree(frozen_hub.IndexOf(0)) == 19999 );
+  for(int64 to = 1; to < 20000; ++to) {
+    double expected = to % 3 == 0 || to % 5 == 1 ? 1.0 : to * 0.5;
+    REQUIRE( hub.Weight(0, to) == expected );
+    REQUIRE( frozen_hub.Weight(0, to) == expected );
+  }
+}
+
+TEST_CASE( "landmark A* finds shortest paths and survives a restart", "[landmarks]" ) {
+  auto graph = make_random_graph(400, 900, 31);
+  CsrGraph frozen = graph->Freeze();
+  LandmarkIndex index = LandmarkIndex::Build(frozen, 8);
+  REQUIRE( index.landmarks().size() == 8 );
+  for(int64 from = 0; from < 400; from += 17) {
+    for(int64 to = 0; to < 400; to += 13) {
+      int32 u = frozen.IndexOf(from), v = frozen.IndexOf(to);
+      int64 expected = reference_distance(frozen, from, to);
+      // the bound really is a lower bound, or a correct "no path"
+      if(expected == -1) {
+        REQUIRE( index.ShortestPath(frozen, from, to).empty() );
+        continue;
+      }
+      REQUIRE( index.LowerBound(u, v) <= expected );
+      std::vector<int64> path = index.ShortestPath(frozen, from, to);
+      REQUIRE( static_cast<int64>(path.size()) == expected + 1 );
+      REQUIRE( path.front() == from );
+      REQUIRE( path.back() == to );
+      for(size_t i = 0; i + 1 < path.size(); ++i) {
+        REQUIRE( frozen.IsConnected(path[i], path[i + 1]) );
+      }
+    }
+  }
+  // no landmarks at all still gives right answers, just slower
+  LandmarkIndex empty;
+  REQUIRE( empty.ShortestPath(frozen, 3, 250).size() ==
+           frozen.ShortestPath(3, 250).size() );
+
+  const char* path = "landmarks_test.bin";
+  REQUIRE( index.Save(path) );
+  LandmarkIndex loaded;
+  REQUIRE( LandmarkIndex::Load(path, frozen, &loaded) );
+  REQUIRE( loaded.landmarks() == index.landmarks() );
+  for(int32 u = 0; u < 400; u += 7) {
+    REQUIRE( loaded.LowerBound(u, 100) == index.LowerBound(u, 100) );
+  }
+  // an index for some other graph is refused
+  CsrGraph other = make_random_graph(300, 900, 31)->Freeze();
+  REQUIRE( !LandmarkIndex::Load(path, other, &loaded) );
+  REQUIRE( !LandmarkIndex::Load("no_such_file.bin", frozen, &loaded) );
+  std::remove(path);
+}
+
+TEST_CASE( "pruned landmark labels give exact distances", "[labels]" ) {
+  auto graph = make_random_graph(400, 1000, 41);
+  CsrGraph frozen = graph->Freeze();
+  DistanceIndex serial = DistanceIndex::Build(graph.get(), nullptr);
+  ThreadPool pool(4);
+  DistanceIndex parallel = DistanceIndex::Build(frozen, &pool);
+  REQUIRE( serial.MemoryBytes() > serial.LabelSize() * 8 );
+  REQUIRE( parallel.LabelSize() > 0 );
+  for(int64 from = 0; from < 400; from += 11) {
+    for(int64 to = 0; to < 400; to += 3) {
+      int64 expected = reference_distance(frozen, from, to);
+      REQUIRE( serial.Distance(from, to) == expected );
+      REQUIRE( parallel.Distance(from, to) == expected );
+    }
+    std::vector<int64> path = serial.ShortestPath(graph.get(), from, 200);
+    REQUIRE( static_cast<int64>(path.size()) ==
+             reference_distance(frozen, from, 200) + 1 );
+  }
+  REQUIRE( serial.Distance(5, 12345) == -1 );
+  REQUIRE( DistanceIndex().Distance(1, 1) == -1 );
+}
+
+TEST_CASE( "reachability index agrees with search", "[reachability]" ) {
+  // sparse enough to leave plenty of pairs unreachable
+  auto graph = make_random_graph(500, 600, 53);
+  CsrGraph frozen = graph->Freeze();
+  Components components = StronglyConnectedComponents(frozen);
+  CsrGraph dag = Condensation(frozen, components);
+  REQUIRE( dag.Count() == components.count );
+  // numbering is a reverse topological order
+  for(int32 c = 0; c < dag.Count(); ++c) {
+    for(int32 d : dag.OutNeighbors(c)) REQUIRE( d < c );
+  }
+  ReachabilityIndex index = ReachabilityIndex::Build(frozen);
+  int reachable = 0;
+  for(int64 from = 0; from < 500; from += 7) {
+    for(int64 to = 0; to < 500; to += 3) {
+      bool expected = reference_distance(frozen, from, to) != -1;
+      REQUIRE( index.IsReachable(from, to) == expected );
+      if(components.component[frozen.IndexOf(from)] ==
+         components.component[frozen.IndexOf(to)]) {
+        REQUIRE( expected );
+      }
+      reachable += expected;
+    }
+  }
+  REQUIRE( reachable > 0 );
+  REQUIRE( !index.IsReachable(3, 99999) );
+  REQUIRE( !ReachabilityIndex().IsReachable(0, 0) );
+}
+
+TEST_CASE( "parallel components match Tarjan's", "[scc]" ) {
+  auto graph = make_random_graph(2000, 2600, 61);
+  // a long chain hanging off the side, and a cycle along part of it
+  for(int64 i = 2000; i < 6000; ++i) {
+    graph->AddNode(i);
+    graph->Connect(i - 1, i);
+  }
+  graph->Connect(5000, 4000);
+  graph->Connect(3000, 3000);
+  CsrGraph frozen = graph->Freeze();
+  Components serial = StronglyConnectedComponents(frozen);
+  ThreadPool pool(4);
+  Components parallel = ParallelStronglyConnectedComponents(frozen, &pool);
+  REQUIRE( parallel.count == serial.count );
+  REQUIRE( ParallelStronglyConnectedComponents(frozen, nullptr).component ==
+           serial.component );
+  // same partition, even if the numbers differ: map one onto the other
+  std::vector<int32> mapping(serial.count, -1);
+  for(int32 v = 0; v < frozen.Count(); ++v) {
+    int32 s = serial.component[v];
+    int32 p = parallel.component[v];
+    REQUIRE( p >= 0 );
+    REQUIRE( p < parallel.count );
+    if(mapping[s] == -1) mapping[s] = p;
+    REQUIRE( mapping[s] == p );
+  }
+  // the cycle on the chain is one component of 1001 nodes
+  FlatIdMap<int32> by_id = StronglyConnectedComponents(graph.get(), &pool);
+  int32 cycle = by_id.at(4500);
+  int64 size = 0;
+  for(auto& kv : by_id) size += kv.second == cycle;
+  REQUIRE( size == 1001 );
+  REQUIRE( by_id.at(3000) != by_id.at(3001) );
+  REQUIRE( StronglyConnectedComponents(graph.get(), nullptr).size() == 6000 );
+}
+
+TEST_CASE( "weakly connected components, batch and incremental", "[wcc]" ) {
+  auto graph = make_random_graph(3000, 2000, 71);
+  CsrGraph frozen = graph->Freeze();
+  ThreadPool pool(4);
+  Components parallel = WeaklyConnectedComponents(frozen, &pool);
+  Components serial = WeaklyConnectedComponents(frozen, nullptr);
+  REQUIRE( parallel.component == serial.component );
+  // the components of a plain search over both directions match
+  std::vector<int32> seen(frozen.Count(), -1);
+  int32 found = 0;
+  for(int32 start = 0; start < frozen.Count(); ++start) {
+    if(seen[start] != -1) continue;
+    REQUIRE( parallel.component[start] == found );
+    std::vector<int32> stack(1, start);
+    seen[start] = found;
+    while(!stack.empty()) {
+      int32 u = stack.back();
+      stack.pop_back();
+      REQUIRE( parallel.component[u] == found );
+      for(CsrGraph::Neighbors row : {frozen.OutNeighbors(u),
+                                     frozen.InNeighbors(u)}) {
+        for(int32 v : row) {
+          if(seen[v] != -1) continue;
+          seen[v] = found;
+          stack.push_back(v);
+        }
+      }
+    }
+    ++found;
+  }
+  REQUIRE( parallel.count == found );
+
+  // the graph turns down paths between components without a search, and
+  // notices new edges right away
+  Graph small;
+  for(int64 i = 0; i < 6; ++i) small.AddNode(i);
+  small.Connect(0, 1);
+  small.Connect(1, 2);
+  small.Connect(4, 3);
+  REQUIRE( small.ShortestPath(0, 3).empty() );
+  small.Connect(2, 3);
+  REQUIRE( small.ShortestPath(0, 3).size() == 4 );
+  // 3 -> 0 is in the same component but has no path, that still works
+  REQUIRE( small.ShortestPath(3, 0).empty() );
+  small.ConnectBatch({{3, 5}}, nullptr);
+  REQUIRE( small.ShortestPath(0, 5).size() == 5 );
+  Graph copy = small.CowCopy();
+  small.Disconnect(2, 3);
+  REQUIRE( small.ShortestPath(0, 3).empty() );
+  REQUIRE( copy.ShortestPath(0, 3).size() == 4 );
+  // enough removals to rebuild, and a deleted id coming back
+  small.Delete(3);
+  small.Delete(5);
+  for(int round = 0; round < 10; ++round) {
+    small.Connect(0, 2);
+    small.Disconnect(0, 2);
+  }
+  small.AddNode(3);
+  REQUIRE( small.ShortestPath(0, 3).empty() );
+  REQUIRE( small.ShortestPath(4, 3).empty() );
+  small.Connect(2, 3);
+  REQUIRE( small.ShortestPath(0, 3).size() == 4 );
+  REQUIRE( small.WeightedShortestPath(4, 0).empty() );
+}
+
+TEST_CASE( "pagerank and personalized pagerank", "[pagerank]" ) {
+  CsrGraph frozen = make_random_graph(2000, 10000, 83)->Freeze();
+  int64 count = frozen.Count();
+  ThreadPool pool(4);
+  // the textbook push version, dangling nodes jumping anywhere
+  std::vector<double> expected(count, 1.0 / count);
+  for(int iteration = 0; iteration < 200; ++iteration) {
+    std::vector<double> next(count, 0.0);
+    double dangling = 0;
+    for(int32 u = 0; u < count; ++u) {
+      if(frozen.OutDegree(u) == 0) dangling += expected[u];
+      for(int32 v : frozen.OutNeighbors(u)) {
+        next[v] += 0.85 * expected[u] / frozen.OutDegree(u);
+      }
+    }
+    for(int32 v = 0; v < count; ++v) {
+      next[v] += (0.15 + 0.85 * dangling) / count;
+    }
+    expected.swap(next);
+  }
+  std::vector<double> serial = PageRank<double>(frozen, 0.85, 1e-12, 200,
+                                                nullptr);
+  std::vector<double> parallel = PageRank<double>(frozen, 0.85, 1e-12, 200,
+                                                  &pool);
+  std::vector<float> single = PageRank<float>(frozen, 0.85f, 1e-5f, 200,
+                                              &pool);
+  double total = 0;
+  for(int32 v = 0; v < count; ++v) {
+    REQUIRE( serial[v] == Approx(expected[v]).epsilon(1e-6) );
+    REQUIRE( parallel[v] == Approx(expected[v]).epsilon(1e-6) );
+    REQUIRE( std::fabs(single[v] - expected[v]) < 1e-5 );
+    total += parallel[v];
+  }
+  REQUIRE( total == Approx(1.0) );
+  // one iteration is not converged yet
+  std::vector<double> rough = PageRank<double>(frozen, 0.85, 1e-12, 1,
+                                               &pool);
+  double change = 0;
+  for(int32 v = 0; v < count; ++v) change += std::fabs(rough[v] - serial[v]);
+  REQUIRE( change > 1e-6 );
+
+  // a chain 0 -> 1 -> 2 and a separate 3 -> 0: personalized on 0, node 3
+  // can't be reached and 0 beats everything downstream of it
+  CsrGraph chain = CsrGraph::FromEdges({{0, 1}, {1, 2}, {3, 0}});
+  std::vector<double> near = PersonalizedPageRank<double>(
+    chain, {chain.IndexOf(0)}, 0.85, 1e-12, 500, &pool);
+  REQUIRE( near[chain.IndexOf(3)] == 0.0 );
+  REQUIRE( near[chain.IndexOf(0)] > near[chain.IndexOf(1)] );
+  REQUIRE( near[chain.IndexOf(1)] > near[chain.IndexOf(2)] );
+  REQUIRE( near[0] + near[1] + near[2] + near[3] == Approx(1.0) );
+  // personalized on every node is plain pagerank
+  std::vector<int32> everyone;
+  for(int32 v = 0; v < count; ++v) everyone.push_back(v);
+  std::vector<double> all = PersonalizedPageRank<double>(
+    frozen, everyone, 0.85, 1e-12, 200, &pool);
+  for(int32 v = 0; v < count; ++v) {
+    REQUIRE( all[v] == Approx(serial[v]).epsilon(1e-9) );
+  }
+  REQUIRE( PageRank<float>(CsrGraph(), 0.85f, 1e-6f, 10, &pool).empty() );
+}
+
+TEST_CASE( "triangle counting and clustering coefficients", "[triangles]" ) {
+  ThreadPool pool(4);
+  // a few hubs, so the degree orientation has something to do
+  auto graph = make_random_graph(500, 6000, 97);
+  for(int64 hub = 0; hub < 3; ++hub) {
+    for(int64 v = 0; v < 500; v += 2) graph->Connect(hub, v);
+  }
+  graph->Connect(5, 5);
+  CsrGraph frozen = graph->Freeze();
+  CsrGraph both = frozen.Symmetrized();
+  REQUIRE( both.Count() == frozen.Count() );
+  for(int32 u = 0; u < frozen.Count(); ++u) {
+    for(int32 v : frozen.OutNeighbors(u)) {
+      REQUIRE( both.IsConnected(frozen.IdOf(u), frozen.IdOf(v)) );
+      REQUIRE( both.IsConnected(frozen.IdOf(v), frozen.IdOf(u)) );
+    }
+    REQUIRE( both.OutDegree(u) == both.InDegree(u) );
+    REQUIRE( both.OutDegree(u) <= frozen.OutDegree(u) + frozen.InDegree(u) );
+  }
+  // every triangle once, as u < v < w
+  std::vector<int64> expected(frozen.Count(), 0);
+  int64 total = 0;
+  for(int32 u = 0; u < both.Count(); ++u) {
+    CsrGraph::Neighbors row = both.OutNeighbors(u);
+    for(int32 v : row) {
+      if(v <= u) continue;
+      for(int32 w : both.OutNeighbors(v)) {
+        if(w <= v || !std::binary_search(row.begin(), row.end(), w)) continue;
+        ++total;
+        ++expected[u];
+        ++expected[v];
+        ++expected[w];
+      }
+    }
+  }
+  REQUIRE( total > 0 );
+  REQUIRE( CountTriangles(frozen, nullptr) == total );
+  REQUIRE( CountTriangles(frozen, &pool) == total );
+  REQUIRE( TriangleCounts(frozen, nullptr) == expected );
+  REQUIRE( TriangleCounts(frozen, &pool) == expected );
+  std::vector<double> coefficients = ClusteringCoefficients(frozen, &pool);
+  for(int32 v = 0; v < frozen.Count(); ++v) {
+    int64 degree = both.OutDegree(v) - (both.IsConnected(frozen.IdOf(v),
+                                                         frozen.IdOf(v)));
+    double pairs = degree * (degree - 1) / 2.0;
+    REQUIRE( coefficients[v] ==
+             Approx(degree < 2 ? 0.0 : expected[v] / pairs) );
+  }
+
+  // a 4-clique with edges in both directions and one pendant node
+  CsrGraph clique = CsrGraph::FromEdges({{1, 2}, {2, 1}, {1, 3}, {4, 1},
+                                         {2, 3}, {2, 4}, {3, 4}, {4, 5}});
+  REQUIRE( CountTriangles(clique, &pool) == 4 );
+  std::vector<double> tight = ClusteringCoefficients(clique, nullptr);
+  REQUIRE( tight[clique.IndexOf(1)] == Approx(1.0) );
+  REQUIRE( tight[clique.IndexOf(4)] == Approx(0.5) );
+  REQUIRE( tight[clique.IndexOf(5)] == 0.0 );
+  REQUIRE( CountTriangles(CsrGraph(), &pool) == 0 );
+}
+
+TEST_CASE( "k-core decomposition", "[kcore]" ) {
+  ThreadPool pool(4);
+  auto graph = make_random_graph(400, 3000, 101);
+  graph->Connect(7, 7);
+  CsrGraph frozen = graph->Freeze();
+  CsrGraph both = frozen.Symmetrized();
+  // the definition: peel below k until nothing changes, for every k
+  std::vector<int32> expected(frozen.Count(), 0);
+  for(int32 k = 1; ; ++k) {
+    std::vector<bool> alive(frozen.Count(), true);
+    bool changed = true;
+    while(changed) {
+      changed = false;
+      for(int32 v = 0; v < both.Count(); ++v) {
+        if(!alive[v]) continue;
+        int32 degree = 0;
+        for(int32 w : both.OutNeighbors(v)) degree += w != v && alive[w];
+        if(degree < k) {
+          alive[v] = false;
+          changed = true;
+        }
+      }
+    }
+    bool any = false;
+    for(int32 v = 0; v < both.Count(); ++v) {
+      if(alive[v]) {
+        expected[v] = k;
+        any = true;
+      }
+    }
+    if(!any) break;
+  }
+  REQUIRE( CoreNumbers(frozen) == expected );
+  REQUIRE( ParallelCoreNumbers(frozen, nullptr) == expected );
+  REQUIRE( ParallelCoreNumbers(frozen, &pool) == expected );
+
+  // big enough for rounds to go to the pool
+  CsrGraph big = make_random_graph(30000, 150000, 103)->Freeze();
+  std::vector<int32> serial = CoreNumbers(big);
+  REQUIRE( ParallelCoreNumbers(big, &pool) == serial );
+
+  FlatIdMap<int32> by_id = CoreNumbers(graph.get(), &pool);
+  REQUIRE( by_id.size() == frozen.Count() );
+  for(int32 v = 0; v < frozen.Count(); ++v) {
+    REQUIRE( by_id.at(frozen.IdOf(v)) == expected[v] );
+  }
+  REQUIRE( CoreNumbers(CsrGraph()).empty() );
+  REQUIRE( ParallelCoreNumbers(CsrGraph(), &pool).empty() );
+}
+
+TEST_CASE( "exact and sampled betweenness centrality", "[betweenness]" ) {
+  ThreadPool pool(4);
+  CsrGraph frozen = make_random_graph(150, 450, 107)->Freeze();
+  int32 count = frozen.Count();
+  // straight from the definition: v is on sigma(s, v) * sigma(v, t) of
+  // the sigma(s, t) shortest s -> t paths if it is on any
+  std::vector<std::vector<int32>> distance(count);
+  std::vector<std::vector<double>> paths(count);
+  for(int32 s = 0; s < count; ++s) {
+    distance[s].assign(count, -1);
+    paths[s].assign(count, 0.0);
+    distance[s][s] = 0;
+    paths[s][s] = 1;
+    std::vector<int32> queue(1, s);
+    for(size_t head = 0; head < queue.size(); ++head) {
+      int32 u = queue[head];
+      for(int32 v : frozen.OutNeighbors(u)) {
+        if(distance[s][v] == -1) {
+          distance[s][v] = distance[s][u] + 1;
+          queue.push_back(v);
+        }
+        if(distance[s][v] == distance[s][u] + 1) paths[s][v] += paths[s][u];
+      }
+    }
+  }
+  std::vector<double> expected(count, 0.0);
+  for(int32 s = 0; s < count; ++s) {
+    for(int32 t = 0; t < count; ++t) {
+      if(s == t || distance[s][t] == -1) continue;
+      for(int32 v = 0; v < count; ++v) {
+        if(v == s || v == t || distance[s][v] == -1 ||
+           distance[v][t] == -1 ||
+           distance[s][v] + distance[v][t] != distance[s][t]) {
+          continue;
+        }
+        expected[v] += paths[s][v] * paths[v][t] / paths[s][t];
+      }
+    }
+  }
+  std::vector<double> serial = Betweenness(frozen, nullptr);
+  std::vector<double> parallel = Betweenness(frozen, &pool);
+  for(int32 v = 0; v < count; ++v) {
+    REQUIRE( serial[v] == Approx(expected[v]).margin(1e-9) );
+    REQUIRE( parallel[v] == Approx(expected[v]).margin(1e-9) );
+  }
+
+  // the sampled estimate stays inside the bound it promises
+  double epsilon = 0.05;
+  int64 samples = BetweennessSamples(count, epsilon, 0.01);
+  REQUIRE( BetweennessSamples(150, 0.05, 0.01) == 2062 );
+  REQUIRE( BetweennessSamples(1000000000, 0.01, 0.1) == 118595 );
+  REQUIRE( BetweennessSamples(0, 0.05, 0.01) == 0 );
+  REQUIRE( BetweennessSamples(150, 0.0, 0.01) == 0 );
+  REQUIRE( BetweennessSamples(150, -0.5, 0.01) == 0 );
+  REQUIRE( BetweennessSamples(150, 0.05, 0.0) == 0 );
+  REQUIRE( BetweennessSamples(150, 0.05, 1000.0) == 0 );
+  REQUIRE( BetweennessSamples(150, 1e-300, 0.01) ==
+           std::numeric_limits<int64>::max() );
+  std::vector<double> estimate = ApproximateBetweenness(frozen, samples, 3,
+                                                        &pool);
+  for(int32 v = 0; v < count; ++v) {
+    REQUIRE( std::fabs(estimate[v] - expected[v]) <=
+             epsilon * count * (count - 2) );
+  }
+  // same seed, same sources
+  std::vector<double> again = ApproximateBetweenness(frozen, samples, 3,
+                                                     nullptr);
+  for(int32 v = 0; v < count; ++v) {
+    REQUIRE( again[v] == Approx(estimate[v]).margin(1e-9) );
+  }
+
+  // the middle of a chain is on the one path around it
+  CsrGraph chain = CsrGraph::FromEdges({{1, 2}, {2, 3}});
+  std::vector<double> middle = Betweenness(chain, &pool);
+  REQUIRE( middle[chain.IndexOf(1)] == 0.0 );
+  REQUIRE( middle[chain.IndexOf(2)] == 1.0 );
+  REQUIRE( middle[chain.IndexOf(3)] == 0.0 );
+  REQUIRE( Betweenness(CsrGraph(), &pool).empty() );
+}
+
+TEST_CASE( "seeded graph generators", "[generators]" ) {
+  ThreadPool pool(4);
+  typedef std::vector<std::pair<int64, int64>> Edges;
+  // whatever the pool, the same edges in the same order
+  Edges rmat = RMatEdges(12, 200000, 0.57, 0.19, 0.19, 5, &pool);
+  REQUIRE( rmat == RMatEdges(12, 200000, 0.57, 0.19, 0.19, 5, nullptr) );
+  REQUIRE( rmat != RMatEdges(12, 200000, 0.57, 0.19, 0.19, 6, &pool) );
+  REQUIRE( rmat.size() == 200000 );
+  REQUIRE( std::all_of(rmat.begin(), rmat.end(),
+                       [](const std::pair<int64, int64>& edge) {
+    return edge.first >= 0 && edge.first < 4096 &&
+      edge.second >= 0 && edge.second < 4096;
+  }) );
+  // skewed: node 0 gets about 0.76^12 of the sources, 70 times its share
+  CsrGraph skewed = CsrGraph::FromEdges(rmat);
+  REQUIRE( skewed.OutDegree(skewed.IndexOf(0)) > 20 * skewed.EdgeCount() /
+           skewed.Count() );
+
+  Edges sparse = ErdosRenyiEdges(3000, 0.01, 7, &pool);
+  REQUIRE( sparse == ErdosRenyiEdges(3000, 0.01, 7, nullptr) );
+  REQUIRE( std::is_sorted(sparse.begin(), sparse.end()) );
+  REQUIRE( std::adjacent_find(sparse.begin(), sparse.end()) == sparse.end() );
+  // 89970 expected, the standard deviation is about 300
+  REQUIRE( std::fabs(sparse.size() - 89970.0) < 1500 );
+  REQUIRE( std::all_of(sparse.begin(), sparse.end(),
+                       [](const std::pair<int64, int64>& edge) {
+    return edge.first != edge.second && edge.second < 3000;
+  }) );
+  REQUIRE( ErdosRenyiEdges(50, 1.0, 7, &pool).size() == 50 * 49 );
+  REQUIRE( ErdosRenyiEdges(50, 0.0, 7, &pool).empty() );
+
+  Edges exact = RandomEdges(1000, 50000, 9, &pool);
+  REQUIRE( exact == RandomEdges(1000, 50000, 9, nullptr) );
+  REQUIRE( exact.size() == 50000 );
+  REQUIRE( std::is_sorted(exact.begin(), exact.end()) );
+  REQUIRE( std::adjacent_find(exact.begin(), exact.end()) == exact.end() );
+  // the dense side leaves edges out instead
+  Edges dense = RandomEdges(100, 9000, 9, &pool);
+  REQUIRE( dense.size() == 9000 );
+  REQUIRE( std::adjacent_find(dense.begin(), dense.end()) == dense.end() );
+  REQUIRE( std::none_of(dense.begin(), dense.end(),
+                        [](const std::pair<int64, int64>& edge) {
+    return edge.first == edge.second;
+  }) );
+  REQUIRE( RandomEdges(10, 90, 1, &pool).size() == 90 );
+
+  Edges attached = BarabasiAlbertEdges(20000, 4, 11, &pool);
+  REQUIRE( attached == BarabasiAlbertEdges(20000, 4, 11, nullptr) );
+  REQUIRE( attached.size() == 80000 );
+  bool older = true;
+  for(int64 e = 0; e < 80000; ++e) {
+    older = older && attached[e].first == e / 4 &&
+      attached[e].second <= attached[e].first;
+  }
+  REQUIRE( older );
+  // the oldest nodes collect far more than the 8 edges of an average one
+  CsrGraph hubs = CsrGraph::FromEdges(attached);
+  REQUIRE( hubs.InDegree(hubs.IndexOf(0)) > 100 );
+
+  // straight into a Graph through the bulk path
+  Graph graph;
+  graph.AddAndConnectBatch(sparse, &pool);
+  REQUIRE( graph.Count() == 3000 );
+  REQUIRE( graph.Freeze().EdgeCount() == static_cast<int64>(sparse.size()) );
+}
+
+TEST_CASE( "csr searches reuse their arrays across graphs and threads",
+           "[csr]" ) {
+  CsrGraph small = CsrGraph::FromEdges({{1, 2}, {2, 3}, {7, 1}});
+  auto big = make_random_graph(2000, 5000, 17);
+  CsrGraph large = big->Freeze();
+  std::vector<std::vector<int64>> expected;
+  for(int64 from = 0; from < 2000; from += 97) {
+    expected.push_back(big->ShortestPath(from, 1999 - from));
+  }
+  // a big search, then the small snapshot again on the same thread
+  REQUIRE( large.ShortestPath(0, 1999).size() == expected[0].size() );
+  REQUIRE( small.ShortestPath(7, 3).size() == 4 );
+  REQUIRE( small.ShortestPath(3, 7).empty() );
+  std::atomic<int> wrong(0);
+  std::vector<std::thread> threads;
+  for(int t = 0; t < 4; ++t) {
+    threads.emplace_back([&]() {
+      for(int round = 0; round < 5; ++round) {
+        size_t i = 0;
+        for(int64 from = 0; from < 2000; from += 97, ++i) {
+          std::vector<int64> path = large.ShortestPath(from, 1999 - from);
+          if(path.size() != expected[i].size()) ++wrong;
+        }
+      }
+    });
+  }
+  for(std::thread& thread : threads) thread.join();
+  REQUIRE( wrong == 0 );
+}
@@ -0,0 +1,43 @@
+#include "mapped_file.hpp"
+#include<string>
+#include<memory>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<fcntl.h>
+#include<unistd.h>
+
+std::unique_ptr<MappedFile> MappedFile::Open(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if(fd == -1) return nullptr;
+  struct stat info;
+  if(fstat(fd, &info) == -1) {
+    close(fd);
+    return nullptr;
+  }
+  int64 size = info.st_size;
+  // mmap refuses zero length mappings, but an empty file is still a file
+  const char* data = nullptr;
+  if(size > 0) {
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(mapped == MAP_FAILED) {
+      close(fd);
+      return nullptr;
+    }
+    data = static_cast<const char*>(mapped);
+  }
+  // the mapping stays valid after the descriptor is closed
+  close(fd);
+  return std::unique_ptr<MappedFile>(new MappedFile(data, size));
+}
+
+MappedFile::~MappedFile() {
+  if(data_ != nullptr) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+}
+
+void MappedFile::AdviseSequential() const {
+  if(data_ != nullptr) {
+    madvise(const_cast<char*>(data_), size_, MADV_SEQUENTIAL);
+  }
+}
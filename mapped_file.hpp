@@ -0,0 +1,35 @@
+#ifndef MAPPED_FILE_H_INCLUDE
+#define MAPPED_FILE_H_INCLUDE
+#include<string>
+#include<memory>
+
+typedef long long int64;
+
+// A whole file mapped read-only into memory with mmap. Pages are read in
+// by the kernel the first time they are touched, so opening is cheap no
+// matter how big the file is. The mapping goes away with the object.
+class MappedFile {
+ public:
+  // Maps the file at path. Returns nullptr if it can't be opened or
+  // mapped.
+  static std::unique_ptr<MappedFile> Open(const std::string& path);
+  ~MappedFile();
+
+  const char* data() const { return data_; }
+  int64 size() const { return size_; }
+
+  // Tells the kernel we are about to read the whole thing front to back,
+  // so it can read ahead aggressively.
+  void AdviseSequential() const;
+
+ private:
+  MappedFile(const char* data, int64 size) : data_(data), size_(size) {}
+  // no copies, the destructor unmaps
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* data_;
+  int64 size_;
+};
+
+#endif
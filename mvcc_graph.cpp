@@ -0,0 +1,381 @@
+#include "mvcc_graph.hpp"
+#include "adjacency.hpp"
+#include "bidirectional_search.hpp"
+#include<vector>
+#include<memory>
+#include<mutex>
+#include<thread>
+#include<functional>
+#include<algorithm>
+#include<limits>
+
+namespace {
+
+// every level of the trie picks one of kFanout children with the next
+// kFanoutBits of the mixed id
+const int kFanoutBits = 4;
+const int kFanout = 1 << kFanoutBits;
+// the trie grows a level once the chunks average more nodes than this,
+// which leaves them averaging kChunkNodes / kFanout
+const int64 kChunkNodes = 256;
+// 16^12 chunks, more than there will ever be nodes
+const int kMaxLevels = 12;
+
+uint64_t Mix(int64 id) {
+  // mix the id so consecutive ids spread over all the chunks
+  return static_cast<uint64_t>(id) * 0x9e3779b97f4a7c15ULL;
+}
+
+// which child to take at level (0 is the root)
+int Digit(uint64_t hash, int level) {
+  return (hash >> (64 - kFanoutBits * (level + 1))) & (kFanout - 1);
+}
+
+// Makes *slot safe to change: copies what it points to unless nothing
+// else points there, and adds the entries copied to *copied. Readers
+// never touch the counts and versions are only freed by the writer, so
+// use_count is exact here. The objects are all made non-const, the
+// const_cast only undoes the shared_ptr<const T>.
+template<typename T>
+T* Unshare(std::shared_ptr<const T>* slot, int64 entries, int64* copied) {
+  if(slot->use_count() > 1) {
+    *slot = std::make_shared<T>(**slot);
+    *copied += entries;
+  }
+  return const_cast<T*>(slot->get());
+}
+
+}  // namespace
+
+struct MvccGraph::Version {
+  struct Node {
+    Adjacency outgoing;
+    Adjacency incoming;
+  };
+  typedef FlatIdMap<std::shared_ptr<const Node>> Chunk;
+  // One level of the trie the chunks hang from. The leaves, levels deep,
+  // have a chunk and no children, the rest kFanout children and an empty
+  // chunk. A commit copies the path down to each chunk it touches, so
+  // its cost grows with the depth, not with the number of chunks.
+  struct Trie {
+    std::vector<std::shared_ptr<const Trie>> children;
+    Chunk chunk;
+  };
+
+  const Chunk& ChunkOf(int64 id) const {
+    uint64_t hash = Mix(id);
+    const Trie* trie = root.get();
+    for(int level = 0; level < levels; ++level) {
+      trie = trie->children[Digit(hash, level)].get();
+    }
+    return trie->chunk;
+  }
+
+  const Node* Find(int64 id) const {
+    const std::shared_ptr<const Node>* node = ChunkOf(id).Find(id);
+    return node == nullptr ? nullptr : node->get();
+  }
+
+  // A trie depth levels with a fresh leaf everywhere. The leaves are
+  // added to *leaves in order, so a node goes to leaf
+  // Mix(id) >> (64 - kFanoutBits * depth).
+  static std::shared_ptr<Trie> MakeTrie(int depth,
+                                        std::vector<Trie*>* leaves) {
+    std::shared_ptr<Trie> trie = std::make_shared<Trie>();
+    if(depth == 0) {
+      leaves->push_back(trie.get());
+    } else {
+      trie->children.reserve(kFanout);
+      for(int i = 0; i < kFanout; ++i) {
+        trie->children.push_back(MakeTrie(depth - 1, leaves));
+      }
+    }
+    return trie;
+  }
+
+  // Moves every node into a trie one level deeper. The nodes themselves
+  // are shared, not copied. This is O(count), but the node count has to
+  // grow kFanout times over before it happens again.
+  void Grow() {
+    std::vector<const Trie*> old_leaves;
+    std::vector<const Trie*> pending(1, root.get());
+    while(!pending.empty()) {
+      const Trie* trie = pending.back();
+      pending.pop_back();
+      if(trie->children.empty()) old_leaves.push_back(trie);
+      for(auto& child : trie->children) pending.push_back(child.get());
+    }
+    ++levels;
+    std::vector<Trie*> leaves;
+    std::shared_ptr<Trie> grown = MakeTrie(levels, &leaves);
+    for(const Trie* leaf : old_leaves) {
+      for(const auto& kv : leaf->chunk) {
+        leaves[Mix(kv.first) >> (64 - kFanoutBits * levels)]->chunk.Insert(
+          kv.first, kv.second);
+      }
+    }
+    root = std::move(grown);
+  }
+
+  // a version never changes once published, so the trie, the chunks and
+  // the nodes can be shared by as many versions as still have them in
+  // common
+  std::shared_ptr<const Trie> root;
+  int levels;
+  int64 count;
+};
+
+void MvccGraph::WriteBatch::AddNode(int64 id) {
+  edits_.push_back(Edit{kAddNode, id, id});
+}
+
+void MvccGraph::WriteBatch::Connect(int64 from, int64 to) {
+  edits_.push_back(Edit{kConnect, from, to});
+}
+
+void MvccGraph::WriteBatch::Disconnect(int64 from, int64 to) {
+  edits_.push_back(Edit{kDisconnect, from, to});
+}
+
+void MvccGraph::WriteBatch::Delete(int64 node) {
+  edits_.push_back(Edit{kDelete, node, node});
+}
+
+MvccGraph::ReadView::ReadView(MvccGraph* graph, int slot,
+                              const Version* version) :
+  graph_(graph), slot_(slot), version_(version) {}
+
+MvccGraph::ReadView::ReadView(ReadView&& other) :
+  graph_(other.graph_), slot_(other.slot_), version_(other.version_) {
+  other.graph_ = nullptr;
+}
+
+MvccGraph::ReadView& MvccGraph::ReadView::operator=(ReadView&& other) {
+  if(this != &other) {
+    Release();
+    graph_ = other.graph_;
+    slot_ = other.slot_;
+    version_ = other.version_;
+    other.graph_ = nullptr;
+  }
+  return *this;
+}
+
+MvccGraph::ReadView::~ReadView() {
+  Release();
+}
+
+void MvccGraph::ReadView::Release() {
+  if(graph_ == nullptr) return;
+  graph_->slots_[slot_].epoch.store(kIdle);
+  graph_ = nullptr;
+}
+
+int64 MvccGraph::ReadView::Count() const {
+  return version_->count;
+}
+
+bool MvccGraph::ReadView::Contains(int64 id) const {
+  return version_->Find(id) != nullptr;
+}
+
+bool MvccGraph::ReadView::IsConnected(int64 from, int64 to) const {
+  const Version::Node* node = version_->Find(from);
+  return node != nullptr && node->outgoing.Contains(to);
+}
+
+std::vector<int64> MvccGraph::ReadView::ShortestPath(int64 from,
+                                                     int64 to) const {
+  if(!Contains(from) || !Contains(to)) return std::vector<int64>();
+  const Version* version = version_;
+  // every id reached is a node of this same version, Find can't fail
+  auto successors = [version](int64 id, auto&& f) {
+    version->Find(id)->outgoing.ForEach(f);
+  };
+  auto predecessors = [version](int64 id, auto&& f) {
+    version->Find(id)->incoming.ForEach(f);
+  };
+  return BidirectionalSearch(from, to, successors, predecessors);
+}
+
+MvccGraph::MvccGraph() : epoch_(0), next_id_(0), last_commit_copied_(0) {
+  Version* empty = new Version();
+  // one level to start with. All the leaves can be the same empty one,
+  // commits copy it before they fill it.
+  std::vector<Version::Trie*> leaves;
+  auto root = std::make_shared<Version::Trie>();
+  root->children.assign(kFanout, Version::MakeTrie(0, &leaves));
+  empty->root = std::move(root);
+  empty->levels = 1;
+  empty->count = 0;
+  current_.store(empty);
+  for(ReaderSlot& slot : slots_) slot.epoch.store(kIdle);
+}
+
+MvccGraph::~MvccGraph() {
+  // no views are left (they must not outlive us), so everything can go
+  for(const Retired& retired : retired_) delete retired.version;
+  delete current_.load();
+}
+
+MvccGraph::ReadView MvccGraph::Read() {
+  // start at a slot that depends on the thread, so threads don't all
+  // queue up on the first few
+  int start = std::hash<std::thread::id>()(std::this_thread::get_id()) %
+    kReaderSlots;
+  for(int i = start; ; i = (i + 1) % kReaderSlots) {
+    uint64_t idle = kIdle;
+    if(slots_[i].epoch.load(std::memory_order_relaxed) == kIdle &&
+       slots_[i].epoch.compare_exchange_strong(idle, epoch_.load())) {
+      // the epoch is announced before we look at current_, so whatever
+      // version we get can't be freed until we let go of the slot. Both
+      // are sequentially consistent, which is what makes that true
+      return ReadView(this, i, current_.load());
+    }
+    if((i + 1) % kReaderSlots == start) std::this_thread::yield();
+  }
+}
+
+void MvccGraph::Commit(const WriteBatch& batch) {
+  if(batch.empty()) return;
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  CommitLocked(batch);
+}
+
+void MvccGraph::CommitLocked(const WriteBatch& batch) {
+  typedef Version::Node Node;
+  typedef Version::Chunk Chunk;
+  typedef Version::Trie Trie;
+  std::unique_ptr<Version> next(new Version(*current_.load()));
+  int64 copied = 0;
+  // the chunk id belongs in, made ours to change along with the path
+  // down to it. Whatever this commit copied already has no other owner,
+  // so Unshare leaves it be.
+  auto chunk = [&](int64 id) -> Chunk* {
+    uint64_t hash = Mix(id);
+    Trie* trie = Unshare(&next->root, kFanout, &copied);
+    for(int level = 0; level < next->levels; ++level) {
+      std::shared_ptr<const Trie>* child = &trie->children[Digit(hash, level)];
+      trie = Unshare(child, level + 1 < next->levels ? kFanout :
+                     (*child)->chunk.size(), &copied);
+    }
+    return &trie->chunk;
+  };
+  // a node of next we may change, or nullptr if there is no such node.
+  // The node's own copy isn't counted, that is the edit's cost, not the
+  // version's.
+  auto node = [&](int64 id) -> Node* {
+    if(next->Find(id) == nullptr) return nullptr;
+    int64 ignored = 0;
+    return Unshare(chunk(id)->Find(id), 0, &ignored);
+  };
+
+  for(const WriteBatch::Edit& edit : batch.edits_) {
+    if(edit.kind == WriteBatch::kAddNode) {
+      if(next->Find(edit.from) != nullptr) continue;
+      chunk(edit.from)->Insert(edit.from, std::make_shared<Node>());
+      ++next->count;
+    } else if(edit.kind == WriteBatch::kConnect) {
+      if(next->Find(edit.from) == nullptr || next->Find(edit.to) == nullptr ||
+         next->Find(edit.from)->outgoing.Contains(edit.to)) {
+        continue;
+      }
+      node(edit.from)->outgoing.Insert(edit.to,
+                                       Adjacency::kDefaultHashThreshold);
+      node(edit.to)->incoming.Insert(edit.from,
+                                     Adjacency::kDefaultHashThreshold);
+    } else if(edit.kind == WriteBatch::kDisconnect) {
+      if(next->Find(edit.from) == nullptr || next->Find(edit.to) == nullptr ||
+         !next->Find(edit.from)->outgoing.Contains(edit.to)) {
+        continue;
+      }
+      node(edit.from)->outgoing.Erase(edit.to);
+      node(edit.to)->incoming.Erase(edit.from);
+    } else {
+      int64 id = edit.from;
+      const Node* found = next->Find(id);
+      if(found == nullptr) continue;
+      // a copy, the loops below may replace the node in its chunk
+      Node gone = *found;
+      gone.incoming.ForEach([&](int64 u) {
+        if(u != id) node(u)->outgoing.Erase(id);
+      });
+      gone.outgoing.ForEach([&](int64 v) {
+        if(v != id) node(v)->incoming.Erase(id);
+      });
+      chunk(id)->Erase(id);
+      --next->count;
+    }
+  }
+  if(next->levels < kMaxLevels &&
+     next->count > kChunkNodes << (kFanoutBits * next->levels)) {
+    next->Grow();
+    copied += next->count;
+  }
+  last_commit_copied_.store(copied, std::memory_order_relaxed);
+  Publish(next.release());
+}
+
+int64 MvccGraph::LastCommitCopied() const {
+  return last_commit_copied_.load(std::memory_order_relaxed);
+}
+
+void MvccGraph::Publish(const Version* next) {
+  const Version* old = current_.load();
+  current_.store(next);
+  // readers that announce the new epoch are sure to see next, so old is
+  // safe to free once every pinned reader is at least this far along
+  uint64_t epoch = epoch_.fetch_add(1) + 1;
+  retired_.push_back(Retired{old, epoch});
+  uint64_t oldest = kIdle;
+  for(ReaderSlot& slot : slots_) {
+    oldest = std::min(oldest, slot.epoch.load());
+  }
+  size_t kept = 0;
+  for(const Retired& retired : retired_) {
+    if(retired.epoch <= oldest) {
+      delete retired.version;
+    } else {
+      retired_[kept++] = retired;
+    }
+  }
+  retired_.resize(kept);
+}
+
+int64 MvccGraph::AddNode() {
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  // same as Graph::AddNode, skip ids that are taken
+  const Version* current = current_.load();
+  while(current->Find(next_id_) != nullptr) {
+    next_id_ = (next_id_ % std::numeric_limits<int64>::max()) + 1;
+  }
+  WriteBatch batch;
+  batch.AddNode(next_id_);
+  CommitLocked(batch);
+  return next_id_;
+}
+
+int64 MvccGraph::AddNode(int64 id) {
+  WriteBatch batch;
+  batch.AddNode(id);
+  Commit(batch);
+  return id;
+}
+
+void MvccGraph::Connect(int64 from, int64 to) {
+  WriteBatch batch;
+  batch.Connect(from, to);
+  Commit(batch);
+}
+
+void MvccGraph::Disconnect(int64 from, int64 to) {
+  WriteBatch batch;
+  batch.Disconnect(from, to);
+  Commit(batch);
+}
+
+void MvccGraph::Delete(int64 node) {
+  WriteBatch batch;
+  batch.Delete(node);
+  Commit(batch);
+}
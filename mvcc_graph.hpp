@@ -0,0 +1,150 @@
+#ifndef MVCC_GRAPH_H_INCLUDE
+#define MVCC_GRAPH_H_INCLUDE
+#include<vector>
+#include<atomic>
+#include<mutex>
+#include<cstdint>
+#include "flat_id_map.hpp"
+
+// A graph where readers never wait for writers and never see half of an
+// edit, by keeping several versions of it around (multi version
+// concurrency control).
+//
+// Every commit makes a new immutable version. Versions share everything
+// they have in common: the nodes live in chunks of a few hundred at
+// most, which hang from a 16-way trie that grows a level whenever the
+// graph has grown 16 times over. A commit copies only the chunks and the
+// nodes it touches and the trie levels above those chunks, so it costs
+// about the size of a chunk and the depth of the trie per node it
+// touches, plus the degree of the nodes it changes. None of that grows
+// with the size of the graph, apart from the depth, which grows with its
+// logarithm.
+//
+// A reader calls Read() to pin the newest version and then queries that
+// version for as long as it likes, while writers go on committing. Old
+// versions are freed with epoch based reclamation: every commit advances
+// a global epoch, every pinned reader announces the epoch it started in,
+// and a replaced version is only freed once no reader started before it
+// was replaced. Pinning costs a couple of atomic operations and queries
+// cost none at all, no reference counts are touched.
+//
+// Writers are serialized by a mutex, there is only one commit at a time.
+class MvccGraph {
+ public:
+  // Edits that Commit applies all at once. Readers see either none of
+  // them or all of them.
+  class WriteBatch {
+   public:
+    // Same meaning as the Graph methods. Edits naming nodes that don't
+    // exist (yet) are skipped, they apply in the order they were added.
+    void AddNode(int64 id);
+    void Connect(int64 from, int64 to);
+    void Disconnect(int64 from, int64 to);
+    void Delete(int64 node);
+
+    bool empty() const { return edits_.empty(); }
+
+   private:
+    friend class MvccGraph;
+    enum Kind { kAddNode, kConnect, kDisconnect, kDelete };
+    struct Edit {
+      Kind kind;
+      int64 from;
+      int64 to;
+    };
+    std::vector<Edit> edits_;
+  };
+
+ private:
+  struct Version;
+
+ public:
+  // A pinned version of the graph. The graph must outlive its views, and
+  // a view should not be held longer than needed: versions committed
+  // after it was pinned can't be freed until it is gone.
+  class ReadView {
+   public:
+    ReadView(ReadView&& other);
+    ReadView& operator=(ReadView&& other);
+    ReadView(const ReadView&) = delete;
+    ReadView& operator=(const ReadView&) = delete;
+    ~ReadView();
+
+    // Same as the Graph methods of the same name, on this version.
+    int64 Count() const;
+    bool Contains(int64 id) const;
+    bool IsConnected(int64 from, int64 to) const;
+    std::vector<int64> ShortestPath(int64 from, int64 to) const;
+
+   private:
+    friend class MvccGraph;
+    ReadView(MvccGraph* graph, int slot, const Version* version);
+    void Release();
+
+    MvccGraph* graph_;
+    int slot_;
+    const Version* version_;
+  };
+
+  MvccGraph();
+  ~MvccGraph();
+  MvccGraph(const MvccGraph&) = delete;
+  MvccGraph& operator=(const MvccGraph&) = delete;
+
+  // Pins the newest committed version.
+  ReadView Read();
+
+  // Applies all the edits of the batch as one new version.
+  void Commit(const WriteBatch& batch);
+
+  // Shorthands that commit a single edit. AddNode() picks a free id and
+  // returns it.
+  int64 AddNode();
+  int64 AddNode(int64 id);
+  void Connect(int64 from, int64 to);
+  void Disconnect(int64 from, int64 to);
+  void Delete(int64 node);
+
+  // How many entries (trie children and chunk slots) the last commit had
+  // to copy, besides the nodes it changed. For keeping an eye on commit
+  // cost, it should stay in the hundreds however big the graph gets.
+  int64 LastCommitCopied() const;
+
+ private:
+  // enough for every thread of a big machine to hold a view at once,
+  // Read() waits for a free slot past that
+  static const int kReaderSlots = 128;
+  static const uint64_t kIdle = UINT64_MAX;
+
+  // one announced epoch per cache line, readers pinning at the same time
+  // shouldn't fight over lines
+  struct ReaderSlot {
+    std::atomic<uint64_t> epoch;
+    char padding[64 - sizeof(std::atomic<uint64_t>)];
+  };
+
+  struct Retired {
+    const Version* version;
+    // readers that announced this epoch or later can't be looking at it
+    uint64_t epoch;
+  };
+
+  // Commit with write_mutex_ already held.
+  void CommitLocked(const WriteBatch& batch);
+
+  // Makes next the newest version and frees whatever old versions no
+  // reader can see anymore. Call with write_mutex_ held.
+  void Publish(const Version* next);
+
+  std::mutex write_mutex_;
+  std::atomic<const Version*> current_;
+  std::atomic<uint64_t> epoch_;
+  ReaderSlot slots_[kReaderSlots];
+  // replaced versions not freed yet, only touched under write_mutex_
+  std::vector<Retired> retired_;
+  // where AddNode() starts looking for a free id, under write_mutex_
+  int64 next_id_;
+  std::atomic<int64> last_commit_copied_;
+};
+
+#endif
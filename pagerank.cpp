@@ -0,0 +1,109 @@
+#include "pagerank.hpp"
+#include<vector>
+#include<cmath>
+#include<algorithm>
+
+namespace {
+
+const int64 kGrain = 4096;
+
+// The power iteration itself. teleport[v] is the chance that a random
+// jump lands on v.
+template<typename Real>
+std::vector<Real> Iterate(const CsrGraph& graph,
+                          const std::vector<Real>& teleport, Real damping,
+                          Real tolerance, int max_iterations,
+                          ThreadPool* pool) {
+  int64 count = graph.Count();
+  int threads = pool == nullptr ? 1 : pool->size();
+  std::vector<Real> rank(teleport);
+  std::vector<Real> next(count);
+  // contribution[u] is what u sends down each of its out-edges this
+  // iteration, so the pull loop is a plain sum with no division
+  std::vector<Real> contribution(count);
+  // per thread sums, added up after every pass
+  std::vector<double> partial(threads);
+  const Real* from = contribution.data();
+  for(int iteration = 0; iteration < max_iterations; ++iteration) {
+    std::fill(partial.begin(), partial.end(), 0.0);
+    ParallelFor(pool, count, kGrain, [&](int thread, int64 begin, int64 end) {
+      double dangling = 0;
+      for(int64 u = begin; u < end; ++u) {
+        int64 degree = graph.OutDegree(u);
+        if(degree == 0) {
+          dangling += rank[u];
+          contribution[u] = 0;
+        } else {
+          contribution[u] = rank[u] / degree;
+        }
+      }
+      partial[thread] += dangling;
+    });
+    double dangling = 0;
+    for(double sum : partial) dangling += sum;
+    // dangling rank goes where the jumps go, so it is just more jumping
+    Real jump = (1 - damping) + damping * static_cast<Real>(dangling);
+
+    std::fill(partial.begin(), partial.end(), 0.0);
+    ParallelFor(pool, count, kGrain, [&](int thread, int64 begin, int64 end) {
+      double change = 0;
+      for(int64 v = begin; v < end; ++v) {
+        CsrGraph::Neighbors row = graph.InNeighbors(v);
+        const int32* in = row.begin();
+        int64 degree = row.size();
+        // four independent sums, so the adds don't wait on each other
+        // and the loads of the next edges can start early
+        Real s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+        int64 i = 0;
+        for(; i + 4 <= degree; i += 4) {
+          s0 += from[in[i]];
+          s1 += from[in[i + 1]];
+          s2 += from[in[i + 2]];
+          s3 += from[in[i + 3]];
+        }
+        for(; i < degree; ++i) s0 += from[in[i]];
+        Real value = jump * teleport[v] + damping * ((s0 + s1) + (s2 + s3));
+        change += std::fabs(value - rank[v]);
+        next[v] = value;
+      }
+      partial[thread] += change;
+    });
+    rank.swap(next);
+    double change = 0;
+    for(double sum : partial) change += sum;
+    if(change < tolerance) break;
+  }
+  return rank;
+}
+
+}  // namespace
+
+template<typename Real>
+std::vector<Real> PageRank(const CsrGraph& graph, Real damping,
+                           Real tolerance, int max_iterations,
+                           ThreadPool* pool) {
+  int64 count = graph.Count();
+  if(count == 0) return std::vector<Real>();
+  std::vector<Real> teleport(count, Real(1) / count);
+  return Iterate(graph, teleport, damping, tolerance, max_iterations, pool);
+}
+
+template<typename Real>
+std::vector<Real> PersonalizedPageRank(const CsrGraph& graph,
+                                       const std::vector<int32>& sources,
+                                       Real damping, Real tolerance,
+                                       int max_iterations, ThreadPool* pool) {
+  std::vector<Real> teleport(graph.Count(), 0);
+  for(int32 source : sources) teleport[source] += Real(1) / sources.size();
+  return Iterate(graph, teleport, damping, tolerance, max_iterations, pool);
+}
+
+template std::vector<float> PageRank<float>(
+  const CsrGraph&, float, float, int, ThreadPool*);
+template std::vector<double> PageRank<double>(
+  const CsrGraph&, double, double, int, ThreadPool*);
+template std::vector<float> PersonalizedPageRank<float>(
+  const CsrGraph&, const std::vector<int32>&, float, float, int, ThreadPool*);
+template std::vector<double> PersonalizedPageRank<double>(
+  const CsrGraph&, const std::vector<int32>&, double, double, int,
+  ThreadPool*);
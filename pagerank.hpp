@@ -0,0 +1,39 @@
+#ifndef PAGERANK_H_INCLUDE
+#define PAGERANK_H_INCLUDE
+#include<vector>
+#include "csr_graph.hpp"
+#include "thread_pool.hpp"
+
+// PageRank over a CsrGraph, by power iteration. Real is the type the
+// ranks are kept and summed in, float or double (those are the two that
+// are instantiated): float halves the memory traffic of an iteration,
+// which is most of its cost, at the price of precision, so it is fine for
+// ordering nodes but a tolerance much below 1e-5 won't be reached with it.
+//
+// Every iteration pulls: the new rank of v is a sum over InNeighbors(v),
+// so each thread writes only the ranks of its own nodes and there are no
+// atomics or locks in the loop, and the in-neighbors of v are one
+// contiguous array. Edge weights are ignored, a node splits its rank
+// evenly over its out-edges. Nodes without out-edges (dangling nodes)
+// hand their rank back out the same way the random jump does.
+//
+// damping is the chance of following an edge instead of jumping (0.85 is
+// the usual value). Iterations stop once the ranks changed by less than
+// tolerance in total (the L1 norm of the change), or after
+// max_iterations. The ranks add up to 1. The pool may be nullptr.
+template<typename Real>
+std::vector<Real> PageRank(const CsrGraph& graph, Real damping,
+                           Real tolerance, int max_iterations,
+                           ThreadPool* pool);
+
+// Personalized PageRank: the same, but a random jump always lands on one
+// of sources (dense indices, each equally likely) instead of on any node,
+// so the ranks say how close every node is to the sources. Nodes the
+// sources can't reach end up with rank 0. sources must not be empty.
+template<typename Real>
+std::vector<Real> PersonalizedPageRank(const CsrGraph& graph,
+                                       const std::vector<int32>& sources,
+                                       Real damping, Real tolerance,
+                                       int max_iterations, ThreadPool* pool);
+
+#endif
@@ -0,0 +1,126 @@
+#include "reachability.hpp"
+#include "flat_id_map.hpp"
+#include<vector>
+#include<algorithm>
+#include<utility>
+#include<cstdint>
+
+ReachabilityIndex::ReachabilityIndex() : labels_(0) {
+  components_.count = 0;
+}
+
+ReachabilityIndex ReachabilityIndex::Build(const CsrGraph& graph, int labels,
+                                           unsigned int seed) {
+  ReachabilityIndex index;
+  index.graph_ = graph;
+  index.components_ = StronglyConnectedComponents(graph);
+  index.dag_ = Condensation(graph, index.components_);
+  index.labels_ = std::max(labels, 1);
+  int32 count = index.components_.count;
+  const CsrGraph& dag = index.dag_;
+  index.low_.assign(static_cast<int64>(count) * index.labels_, 0);
+  index.post_.assign(static_cast<int64>(count) * index.labels_, -1);
+  uint64_t state = seed;
+  auto random = [&state]() {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return state >> 33;
+  };
+  std::vector<int32> roots;
+  for(int32 c = 0; c < count; ++c) {
+    if(dag.InDegree(c) == 0) roots.push_back(c);
+  }
+  // the DFS call stack: a component, the edge it started its children
+  // at, and how many of them it has been through
+  struct Call {
+    int32 node;
+    int64 start;
+    int64 done;
+  };
+  std::vector<Call> calls;
+  for(int l = 0; l < index.labels_; ++l) {
+    int32* low = index.low_.data();
+    int32* post = index.post_.data();
+    int labels = index.labels_;
+    // shuffling the roots and starting every child list at a random place
+    // is enough to make the traversals differ
+    for(size_t i = roots.size(); i > 1; --i) {
+      std::swap(roots[i - 1], roots[random() % i]);
+    }
+    int32 next = 0;
+    for(int32 root : roots) {
+      int64 degree = dag.OutDegree(root);
+      calls.push_back(Call{root, degree == 0 ? 0 : int64(random() % degree),
+                           0});
+      low[static_cast<int64>(root) * labels + l] = count;
+      while(!calls.empty()) {
+        Call& call = calls.back();
+        int32 u = call.node;
+        // u's entry for this labeling, in 64 bits since count * labels
+        // can pass 2^31
+        int64 su = static_cast<int64>(u) * labels + l;
+        CsrGraph::Neighbors row = dag.OutNeighbors(u);
+        if(call.done < row.size()) {
+          int32 v = row.begin()[(call.start + call.done++) % row.size()];
+          int64 sv = static_cast<int64>(v) * labels + l;
+          if(post[sv] == -1) {
+            // not seen yet, go down into it
+            int64 child_degree = dag.OutDegree(v);
+            low[sv] = count;
+            calls.push_back(Call{v, child_degree == 0 ? 0 :
+                                 int64(random() % child_degree), 0});
+          } else {
+            // a DAG has no back edges, so v is finished already
+            low[su] = std::min(low[su], low[sv]);
+          }
+          continue;
+        }
+        post[su] = next++;
+        low[su] = std::min(low[su], post[su]);
+        calls.pop_back();
+        if(!calls.empty()) {
+          int64 sp = static_cast<int64>(calls.back().node) * labels + l;
+          low[sp] = std::min(low[sp], low[su]);
+        }
+      }
+    }
+  }
+  return index;
+}
+
+bool ReachabilityIndex::MayReach(int32 a, int32 b) const {
+  // paths between components only go from higher numbers to lower ones
+  if(a < b) return false;
+  const int32* low_a = low_.data() + static_cast<int64>(a) * labels_;
+  const int32* low_b = low_.data() + static_cast<int64>(b) * labels_;
+  const int32* post_a = post_.data() + static_cast<int64>(a) * labels_;
+  const int32* post_b = post_.data() + static_cast<int64>(b) * labels_;
+  for(int l = 0; l < labels_; ++l) {
+    if(low_b[l] < low_a[l] || post_b[l] > post_a[l]) return false;
+  }
+  return true;
+}
+
+bool ReachabilityIndex::IsReachable(int64 from, int64 to) const {
+  int32 u = graph_.IndexOf(from);
+  int32 v = graph_.IndexOf(to);
+  if(u == -1 || v == -1) return false;
+  int32 a = components_.component[u];
+  int32 b = components_.component[v];
+  if(a == b) return true;
+  if(!MayReach(a, b)) return false;
+  // the labels can't rule it out, search the DAG but only go into
+  // components that might still reach b
+  FlatIdMap<bool> seen;
+  seen.Insert(a, true);
+  std::vector<int32> stack(1, a);
+  while(!stack.empty()) {
+    int32 c = stack.back();
+    stack.pop_back();
+    for(int32 d : dag_.OutNeighbors(c)) {
+      if(d == b) return true;
+      if(!MayReach(d, b) || !seen.Insert(d, true)) continue;
+      stack.push_back(d);
+    }
+  }
+  return false;
+}
@@ -0,0 +1,58 @@
+#ifndef REACHABILITY_H_INCLUDE
+#define REACHABILITY_H_INCLUDE
+#include<vector>
+#include "csr_graph.hpp"
+#include "scc.hpp"
+
+// Answers "is there any path from a to b" without a search in most
+// cases, and in particular says no almost instantly.
+//
+// Nodes that can all reach each other (strongly connected components) are
+// the same as far as reachability goes, so the graph is first shrunk to
+// its condensation, which has no cycles. On that DAG we do a few DFS
+// traversals with randomly shuffled child order (GRAIL, Yildirim, Chaoji
+// and Zaki). Each gives every component an interval [lowest post order
+// number below it, its own post order number], and if a reaches b, b's
+// interval sits inside a's in every one of them. So a single interval
+// that doesn't fit proves there is no path. When all of them fit we don't
+// know yet, and fall back to a DFS over the DAG that skips every
+// component whose intervals rule it out.
+//
+// Component numbers give a free extra check: they are a reverse
+// topological order, so paths only go from higher to lower numbers.
+//
+// The index is for one snapshot and has to be rebuilt when the graph
+// changes.
+class ReachabilityIndex {
+ public:
+  // An empty index, nothing is reachable.
+  ReachabilityIndex();
+
+  // Builds the index with this many interval labels per component (more
+  // labels rule out more pairs without a search, each one costs 8 bytes
+  // per component). seed picks the random traversal orders.
+  static ReachabilityIndex Build(const CsrGraph& graph, int labels = 3,
+                                 unsigned int seed = 1);
+
+  // Returns true if there is a path from -> to. Every node reaches itself.
+  // False if either node wasn't in the graph.
+  bool IsReachable(int64 from, int64 to) const;
+
+  // The components the index was built on.
+  const Components& components() const { return components_; }
+
+ private:
+  // true if the intervals of component b fit inside those of a, which has
+  // to be the case if a reaches b
+  bool MayReach(int32 a, int32 b) const;
+
+  CsrGraph graph_;
+  Components components_;
+  CsrGraph dag_;
+  int labels_;
+  // component c's intervals are [low_[c * labels_ + i], post_[...]]
+  std::vector<int32> low_;
+  std::vector<int32> post_;
+};
+
+#endif
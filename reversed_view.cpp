@@ -0,0 +1,20 @@
+#include "reversed_view.hpp"
+#include<vector>
+#include<algorithm>
+
+ReversedView::ReversedView(Graph* graph) : graph_(graph) {}
+
+int64 ReversedView::Count() {
+  return graph_->Count();
+}
+
+bool ReversedView::IsConnected(int64 from, int64 to) {
+  return graph_->IsConnected(to, from);
+}
+
+std::vector<int64> ReversedView::ShortestPath(int64 from, int64 to) {
+  // a path in the reversed graph is a path in the graph walked backwards
+  std::vector<int64> result = graph_->ShortestPath(to, from);
+  std::reverse(result.begin(), result.end());
+  return result;
+}
@@ -0,0 +1,44 @@
+#ifndef REVERSED_VIEW_H_INCLUDE
+#define REVERSED_VIEW_H_INCLUDE
+#include<vector>
+#include "graph.hpp"
+
+// A Graph seen with all its edges turned around, without touching the
+// graph: view.IsConnected(a, b) is graph.IsConnected(b, a) and so on.
+// Unlike Graph::Reverse this is free, and since it only ever reads the
+// graph, forward queries on the graph and backward queries through views
+// can run at the same time (as long as nobody is changing the graph).
+//
+// The view just holds on to the pointer, so the graph has to outlive it.
+// Changes to the graph show up in the view right away.
+class ReversedView {
+ public:
+  explicit ReversedView(Graph* graph);
+
+  // Returns the number of nodes in the graph.
+  int64 Count();
+
+  // Returns true if the graph has a connection to -> from.
+  bool IsConnected(int64 from, int64 to);
+
+  // Return the shortest path between two nodes in the reversed graph,
+  // which is a shortest path from to to from in the graph, backwards. If
+  // no shortest path exists, return an empty vector.
+  std::vector<int64> ShortestPath(int64 from, int64 to);
+
+  // Calls f(v) for every edge id -> v of the reversed graph, that is for
+  // every edge v -> id of the graph.
+  template<typename F>
+  void ForEachSuccessor(int64 id, F f) {
+    graph_->ForEachPredecessor(id, f);
+  }
+  template<typename F>
+  void ForEachPredecessor(int64 id, F f) {
+    graph_->ForEachSuccessor(id, f);
+  }
+
+ private:
+  Graph* graph_;
+};
+
+#endif
@@ -0,0 +1,339 @@
+#include "scc.hpp"
+#include<vector>
+#include<algorithm>
+#include<utility>
+#include<atomic>
+#include<memory>
+#include<functional>
+
+namespace {
+
+// frontiers smaller than this are handled on the calling thread, waking
+// the pool costs more than it saves. It also keeps long chains (one node
+// per level) from turning into a pool round trip per node.
+const size_t kParallelFrontier = 1024;
+
+const int32 kLive = -1;
+const int32 kTaken = -2;
+
+// Shared state of one parallel run. component[v] is kLive until v is
+// assigned; every field is touched by several threads at once.
+struct ParallelState {
+  ParallelState(const CsrGraph& g, ThreadPool* p) :
+    graph(g), reversed(g.Reversed()), pool(p), count(g.Count()),
+    component(new std::atomic<int32>[count]),
+    in_degree(new std::atomic<int32>[count]),
+    out_degree(new std::atomic<int32>[count]),
+    mark(new std::atomic<int32>[count]),
+    next_component(0),
+    local(p->size()) {
+    for(int32 v = 0; v < count; ++v) component[v].store(kLive);
+  }
+
+  bool Live(int32 v) const {
+    return component[v].load(std::memory_order_relaxed) == kLive;
+  }
+
+  // Runs body(thread, v, out) for every v in frontier, spread over the
+  // pool when the frontier is big enough, and returns what the calls put
+  // in out.
+  std::vector<int32> Step(
+    const std::vector<int32>& frontier,
+    const std::function<void(int, int32, std::vector<int32>*)>& body) {
+    if(frontier.size() < kParallelFrontier) {
+      std::vector<int32> next;
+      for(int32 v : frontier) body(0, v, &next);
+      return next;
+    }
+    pool->ParallelFor(frontier.size(), 256,
+                      [&](int thread, int64 begin, int64 end) {
+      for(int64 i = begin; i < end; ++i) {
+        body(thread, frontier[i], &local[thread]);
+      }
+    });
+    std::vector<int32> next;
+    for(std::vector<int32>& part : local) {
+      next.insert(next.end(), part.begin(), part.end());
+      part.clear();
+    }
+    return next;
+  }
+
+  const CsrGraph& graph;
+  CsrGraph reversed;
+  ThreadPool* pool;
+  int32 count;
+  std::unique_ptr<std::atomic<int32>[]> component;
+  // live neighbors left, for trimming
+  std::unique_ptr<std::atomic<int32>[]> in_degree;
+  std::unique_ptr<std::atomic<int32>[]> out_degree;
+  // scratch: search marks, then colors
+  std::unique_ptr<std::atomic<int32>[]> mark;
+  std::atomic<int32> next_component;
+  std::vector<std::vector<int32>> local;
+};
+
+// The nodes still live, in index order.
+std::vector<int32> LiveNodes(ParallelState* state) {
+  std::vector<int32> live;
+  for(int32 v = 0; v < state->count; ++v) {
+    if(state->Live(v)) live.push_back(v);
+  }
+  return live;
+}
+
+// Step 1. Gives every live node that can't be on a cycle (directly or
+// once others are gone) a component of its own.
+void Trim(ParallelState* state) {
+  std::vector<int32> live = LiveNodes(state);
+  // live degrees, self loops don't count
+  std::vector<int32> frontier = state->Step(
+    live, [state](int thread, int32 v, std::vector<int32>* out) {
+    int32 in = 0, outgoing = 0;
+    for(int32 w : state->graph.InNeighbors(v)) {
+      in += w != v && state->Live(w);
+    }
+    for(int32 w : state->graph.OutNeighbors(v)) {
+      outgoing += w != v && state->Live(w);
+    }
+    state->in_degree[v].store(in, std::memory_order_relaxed);
+    state->out_degree[v].store(outgoing, std::memory_order_relaxed);
+    if(in == 0 || outgoing == 0) out->push_back(v);
+  });
+  while(!frontier.empty()) {
+    frontier = state->Step(
+      frontier, [state](int thread, int32 v, std::vector<int32>* out) {
+      // v can be queued twice, when both its degrees hit zero. Only the
+      // first one to get here removes it.
+      int32 live = kLive;
+      if(!state->component[v].compare_exchange_strong(live, kTaken)) return;
+      state->component[v].store(state->next_component++);
+      for(int32 w : state->graph.OutNeighbors(v)) {
+        if(w != v && state->Live(w) && state->in_degree[w].fetch_sub(1) == 1) {
+          out->push_back(w);
+        }
+      }
+      for(int32 w : state->graph.InNeighbors(v)) {
+        if(w != v && state->Live(w) &&
+           state->out_degree[w].fetch_sub(1) == 1) {
+          out->push_back(w);
+        }
+      }
+    });
+  }
+}
+
+// Marks every live node reachable from pivot in graph with tag, by a
+// level synchronous BFS.
+void Reach(ParallelState* state, const CsrGraph& graph, int32 pivot,
+           int32 tag) {
+  state->mark[pivot].store(tag);
+  std::vector<int32> frontier(1, pivot);
+  while(!frontier.empty()) {
+    frontier = state->Step(
+      frontier, [&](int thread, int32 u, std::vector<int32>* out) {
+      for(int32 w : graph.OutNeighbors(u)) {
+        if(!state->Live(w)) continue;
+        if(state->mark[w].load(std::memory_order_relaxed) == tag) continue;
+        if(state->mark[w].exchange(tag) == tag) continue;
+        out->push_back(w);
+      }
+    });
+  }
+}
+
+// Step 2. One forward-backward round from the live node with the most
+// (live) edges both ways.
+void ForwardBackward(ParallelState* state) {
+  std::vector<int32> live = LiveNodes(state);
+  if(live.empty()) return;
+  int32 pivot = live[0];
+  int64 best = -1;
+  for(int32 v : live) {
+    int64 score = int64(state->in_degree[v].load()) * state->out_degree[v];
+    if(score > best) {
+      best = score;
+      pivot = v;
+    }
+  }
+  for(int32 v = 0; v < state->count; ++v) state->mark[v].store(0);
+  // forward marks 1, backward turns the ones it also reaches into 2
+  Reach(state, state->graph, pivot, 1);
+  std::vector<int32> both;
+  state->mark[pivot].store(2);
+  std::vector<int32> frontier(1, pivot);
+  while(!frontier.empty()) {
+    both.insert(both.end(), frontier.begin(), frontier.end());
+    frontier = state->Step(
+      frontier, [state](int thread, int32 u, std::vector<int32>* out) {
+      for(int32 w : state->reversed.OutNeighbors(u)) {
+        // only forward reached nodes can be in the component, and the
+        // backward search can stop at the rest
+        int32 forward = 1;
+        if(state->mark[w].compare_exchange_strong(forward, 2)) {
+          out->push_back(w);
+        }
+      }
+    });
+  }
+  int32 id = state->next_component++;
+  for(int32 v : both) state->component[v].store(id);
+}
+
+// Step 3, until every node has a component.
+void Coloring(ParallelState* state) {
+  std::vector<int32> live = LiveNodes(state);
+  while(!live.empty()) {
+    for(int32 v : live) state->mark[v].store(v);
+    // push the highest color forward until it settles
+    std::vector<int32> frontier = live;
+    while(!frontier.empty()) {
+      frontier = state->Step(
+        frontier, [state](int thread, int32 u, std::vector<int32>* out) {
+        int32 color = state->mark[u].load(std::memory_order_relaxed);
+        for(int32 w : state->graph.OutNeighbors(u)) {
+          if(!state->Live(w)) continue;
+          int32 seen = state->mark[w].load(std::memory_order_relaxed);
+          while(seen < color) {
+            if(state->mark[w].compare_exchange_weak(seen, color)) {
+              out->push_back(w);
+              break;
+            }
+          }
+        }
+      });
+    }
+    // every node that kept its own color roots one component: the nodes
+    // of its color that reach it. Colors don't overlap, so the searches
+    // can't get in each other's way.
+    std::vector<int32> roots;
+    for(int32 v : live) {
+      if(state->mark[v].load() == v) roots.push_back(v);
+    }
+    auto search = [state, &roots](int thread, int64 begin, int64 end) {
+      std::vector<int32> stack;
+      for(int64 i = begin; i < end; ++i) {
+        int32 root = roots[i];
+        int32 id = state->next_component++;
+        state->component[root].store(id);
+        stack.push_back(root);
+        while(!stack.empty()) {
+          int32 u = stack.back();
+          stack.pop_back();
+          for(int32 w : state->reversed.OutNeighbors(u)) {
+            if(state->mark[w].load(std::memory_order_relaxed) != root ||
+               !state->Live(w)) {
+              continue;
+            }
+            state->component[w].store(id);
+            stack.push_back(w);
+          }
+        }
+      }
+    };
+    state->pool->ParallelFor(roots.size(), 16, search);
+    live = LiveNodes(state);
+  }
+}
+
+}  // namespace
+
+Components StronglyConnectedComponents(const CsrGraph& graph) {
+  int32 count = graph.Count();
+  Components result;
+  result.component.assign(count, -1);
+  result.count = 0;
+  // order[v] is when v was first seen, low[v] the earliest node on the
+  // stack that v's subtree can get back to
+  std::vector<int32> order(count, -1);
+  std::vector<int32> low(count, 0);
+  std::vector<int32> stack;
+  // the DFS call stack: a node and how far through its edges we are
+  std::vector<std::pair<int32, int64>> calls;
+  int32 next = 0;
+  for(int32 root = 0; root < count; ++root) {
+    if(order[root] != -1) continue;
+    calls.push_back(std::make_pair(root, 0));
+    order[root] = low[root] = next++;
+    stack.push_back(root);
+    while(!calls.empty()) {
+      int32 u = calls.back().first;
+      CsrGraph::Neighbors row = graph.OutNeighbors(u);
+      int64& e = calls.back().second;
+      if(e < row.size()) {
+        int32 v = row.begin()[e++];
+        if(order[v] == -1) {
+          // go down into v
+          order[v] = low[v] = next++;
+          stack.push_back(v);
+          calls.push_back(std::make_pair(v, 0));
+        } else if(result.component[v] == -1) {
+          // v is still on the stack, part of what we're working on
+          low[u] = std::min(low[u], order[v]);
+        }
+        continue;
+      }
+      // done with u. If nothing below it got back above it, u heads a
+      // component made of everything on the stack down to it.
+      calls.pop_back();
+      if(!calls.empty()) {
+        int32 parent = calls.back().first;
+        low[parent] = std::min(low[parent], low[u]);
+      }
+      if(low[u] == order[u]) {
+        int32 v;
+        do {
+          v = stack.back();
+          stack.pop_back();
+          result.component[v] = result.count;
+        } while(v != u);
+        ++result.count;
+      }
+    }
+  }
+  return result;
+}
+
+CsrGraph Condensation(const CsrGraph& graph, const Components& components) {
+  std::vector<int64> nodes(components.count);
+  for(int32 c = 0; c < components.count; ++c) nodes[c] = c;
+  std::vector<std::pair<int64, int64>> edges;
+  for(int32 u = 0; u < graph.Count(); ++u) {
+    int32 from = components.component[u];
+    for(int32 v : graph.OutNeighbors(u)) {
+      int32 to = components.component[v];
+      if(from != to) edges.push_back(std::make_pair(from, to));
+    }
+  }
+  // FromEdges drops the repeats
+  return CsrGraph::FromEdges(nodes, edges);
+}
+
+Components ParallelStronglyConnectedComponents(const CsrGraph& graph,
+                                               ThreadPool* pool) {
+  if(pool == nullptr) return StronglyConnectedComponents(graph);
+  ParallelState state(graph, pool);
+  Trim(&state);
+  ForwardBackward(&state);
+  // the giant component is gone, which usually leaves more to trim
+  Trim(&state);
+  Coloring(&state);
+  Components result;
+  result.count = state.next_component;
+  result.component.resize(state.count);
+  for(int32 v = 0; v < state.count; ++v) {
+    result.component[v] = state.component[v].load();
+  }
+  return result;
+}
+
+FlatIdMap<int32> StronglyConnectedComponents(Graph* graph, ThreadPool* pool) {
+  CsrGraph frozen = graph->Freeze();
+  Components components = ParallelStronglyConnectedComponents(frozen, pool);
+  FlatIdMap<int32> result;
+  result.Reserve(frozen.Count());
+  for(int32 v = 0; v < frozen.Count(); ++v) {
+    result.Insert(frozen.IdOf(v), components.component[v]);
+  }
+  return result;
+}
@@ -0,0 +1,53 @@
+#ifndef SCC_H_INCLUDE
+#define SCC_H_INCLUDE
+#include<vector>
+#include "graph.hpp"
+#include "csr_graph.hpp"
+#include "flat_id_map.hpp"
+#include "thread_pool.hpp"
+
+// Strongly connected components of a CsrGraph: the largest groups of
+// nodes that can all reach each other. Works on dense indices, except for
+// the Graph overload at the end.
+
+// component[v] is the component of the node with dense index v, from 0 to
+// count - 1.
+struct Components {
+  std::vector<int32> component;
+  int32 count;
+};
+
+// Tarjan's algorithm, with an explicit stack so deep graphs can't blow
+// the call stack. Components are numbered in the order Tarjan finishes
+// them, which is a reverse topological order: every edge between two
+// components goes from a higher number to a lower one.
+Components StronglyConnectedComponents(const CsrGraph& graph);
+
+// The same components found on all the threads of the pool, following
+// the Multistep method (Slota, Rajamanickam and Madduri):
+//  1. trim: nodes with no incoming or no outgoing edges left are
+//     components on their own. Removing them can expose more, so this
+//     runs as a worklist until nothing changes.
+//  2. forward-backward: the nodes both reachable from and reaching a high
+//     degree pivot are one component, which on most real graphs is the
+//     giant one. Two parallel BFS runs find it.
+//  3. coloring: every node left takes the highest index that reaches it,
+//     spread in parallel until nothing changes. Each color is closed
+//     under reaching, so the nodes of color c that reach node c are c's
+//     component, found by one backward search per color, all in parallel.
+//     Repeat on whatever is left.
+// Component numbers come out in no particular order, unlike Tarjan's.
+// With a nullptr pool this is StronglyConnectedComponents(graph).
+Components ParallelStronglyConnectedComponents(const CsrGraph& graph,
+                                               ThreadPool* pool);
+
+// Component numbers straight by node id, for a Graph. Uses the parallel
+// version if there is a pool, Tarjan's otherwise.
+FlatIdMap<int32> StronglyConnectedComponents(Graph* graph, ThreadPool* pool);
+
+// The condensation: one node per component, with id and dense index both
+// equal to the component number, and an edge between two components if
+// any of their nodes have one. It has no cycles.
+CsrGraph Condensation(const CsrGraph& graph, const Components& components);
+
+#endif
@@ -0,0 +1,160 @@
+#include "shortest_paths.hpp"
+#include "dary_heap.hpp"
+#include<vector>
+#include<atomic>
+#include<memory>
+#include<limits>
+#include<utility>
+#include<functional>
+#include<algorithm>
+#include<cmath>
+
+namespace {
+
+const double kInfinity = std::numeric_limits<double>::infinity();
+
+// DeltaStepping raises a delta so small that it would need more buckets
+// than this
+const double kMaxBuckets = 1 << 22;
+
+// Lowers *distance to value if that is smaller. Returns true if it did.
+bool AtomicMin(std::atomic<double>* distance, double value) {
+  double current = distance->load(std::memory_order_relaxed);
+  while(value < current) {
+    if(distance->compare_exchange_weak(current, value,
+                                       std::memory_order_relaxed)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+WeightedTree Dijkstra(const CsrGraph& graph, int32 source, int32 target) {
+  int64 count = graph.Count();
+  WeightedTree tree;
+  tree.distance.assign(count, kInfinity);
+  tree.parent.assign(count, -1);
+  tree.distance[source] = 0;
+  tree.parent[source] = source;
+  // a node can be in the heap several times; stale entries (with more
+  // than the node's current distance) are skipped when they come out,
+  // which is cheaper than a heap that supports decrease-key
+  typedef std::pair<double, int32> Entry;
+  DaryHeap<Entry, 4, std::less<Entry>> heap;
+  heap.push(Entry(0, source));
+  while(!heap.empty()) {
+    Entry top = heap.top();
+    heap.pop();
+    int32 u = top.second;
+    if(top.first > tree.distance[u]) continue;
+    if(u == target) break;
+    CsrGraph::Neighbors row = graph.OutNeighbors(u);
+    const double* weights = graph.OutWeights(u);
+    for(int64 e = 0; e < row.size(); ++e) {
+      int32 v = row.begin()[e];
+      double through = top.first + (weights == nullptr ? 1.0 : weights[e]);
+      if(through < tree.distance[v]) {
+        tree.distance[v] = through;
+        tree.parent[v] = u;
+        heap.push(Entry(through, v));
+      }
+    }
+  }
+  return tree;
+}
+
+std::vector<double> DeltaStepping(const CsrGraph& graph, int32 source,
+                                  double delta, ThreadPool* pool) {
+  if(!(delta > 0) || std::isinf(delta)) {
+    return Dijkstra(graph, source).distance;
+  }
+  int64 count = graph.Count();
+  // no distance is above (count - 1) times the heaviest weight, so this
+  // many buckets of width delta always do
+  double heaviest = 1;
+  if(graph.IsWeighted()) {
+    heaviest = 0;
+    for(int32 u = 0; u < count; ++u) {
+      const double* weights = graph.OutWeights(u);
+      for(int64 e = 0; e < graph.OutDegree(u); ++e) {
+        heaviest = std::max(heaviest, weights[e]);
+      }
+    }
+  }
+  delta = std::max(delta, (count - 1) * heaviest / kMaxBuckets);
+  std::unique_ptr<std::atomic<double>[]> distance(
+    new std::atomic<double>[count]);
+  for(int64 i = 0; i < count; ++i) {
+    distance[i].store(kInfinity, std::memory_order_relaxed);
+  }
+  distance[source].store(0);
+  std::vector<std::vector<int32>> buckets(1, std::vector<int32>(1, source));
+  // which round last took a node out of a bucket, so a node that was
+  // pushed several times is only expanded once per round
+  std::vector<int64> taken(count, -1);
+  int64 round = 0;
+  std::vector<std::vector<int32>> lowered(
+    pool == nullptr ? 1 : pool->size());
+  std::vector<int32> frontier;
+  std::vector<int32> settled;
+
+  // relaxes the light or heavy edges out of nodes in parallel, every
+  // thread collecting the nodes whose distance it lowered
+  auto relax = [&](const std::vector<int32>& nodes, bool light) {
+    auto body = [&](int thread, int64 begin, int64 end) {
+      for(int64 i = begin; i < end; ++i) {
+        int32 u = nodes[i];
+        double from = distance[u].load(std::memory_order_relaxed);
+        CsrGraph::Neighbors row = graph.OutNeighbors(u);
+        const double* weights = graph.OutWeights(u);
+        for(int64 e = 0; e < row.size(); ++e) {
+          double weight = weights == nullptr ? 1.0 : weights[e];
+          if((weight <= delta) != light) continue;
+          int32 v = row.begin()[e];
+          if(AtomicMin(&distance[v], from + weight)) {
+            lowered[thread].push_back(v);
+          }
+        }
+      }
+    };
+    ParallelFor(pool, nodes.size(), 64, body);
+    // put the lowered nodes in the buckets of their new distances. Stale
+    // copies left behind in other buckets get skipped later.
+    for(std::vector<int32>& nodes : lowered) {
+      for(int32 v : nodes) {
+        size_t b = distance[v].load(std::memory_order_relaxed) / delta;
+        if(b >= buckets.size()) buckets.resize(b + 1);
+        buckets[b].push_back(v);
+      }
+      nodes.clear();
+    }
+  };
+
+  for(size_t b = 0; b < buckets.size(); ++b) {
+    settled.clear();
+    // relaxing light edges can land nodes back in this very bucket, so
+    // keep going until it stays empty
+    while(!buckets[b].empty()) {
+      frontier.clear();
+      ++round;
+      for(int32 v : buckets[b]) {
+        size_t now = distance[v].load(std::memory_order_relaxed) / delta;
+        if(now != b || taken[v] == round) continue;
+        taken[v] = round;
+        frontier.push_back(v);
+      }
+      buckets[b].clear();
+      settled.insert(settled.end(), frontier.begin(), frontier.end());
+      relax(frontier, true);
+    }
+    // the distances in this bucket are final now, heavy edges can only
+    // reach later buckets so one pass over them does it
+    relax(settled, false);
+    std::vector<int32>().swap(buckets[b]);
+  }
+  std::vector<double> result(count);
+  for(int64 i = 0; i < count; ++i) result[i] = distance[i].load();
+  return result;
+}
@@ -0,0 +1,39 @@
+#ifndef SHORTEST_PATHS_H_INCLUDE
+#define SHORTEST_PATHS_H_INCLUDE
+#include<vector>
+#include "csr_graph.hpp"
+#include "thread_pool.hpp"
+
+// Single source shortest paths by edge weight over a CsrGraph (an
+// unweighted snapshot counts every edge as 1). Like bfs.hpp, everything
+// here works on dense indices. Weights must not be negative.
+
+// distance[v] is the total weight of a lightest path from the source, or
+// infinity if v can't be reached. parent[v] is the node before v on that
+// path; the source is its own parent and unreachable nodes have -1.
+struct WeightedTree {
+  std::vector<double> distance;
+  std::vector<int32> parent;
+};
+
+// Dijkstra with a 4-ary heap. If target is not -1, stops as soon as the
+// target's distance is known, and only the nodes settled by then have
+// their final distance.
+WeightedTree Dijkstra(const CsrGraph& graph, int32 source, int32 target = -1);
+
+// Delta-stepping (Meyer and Sanders), the parallel cousin of Dijkstra for
+// big single source runs. Nodes go into buckets of width delta by
+// tentative distance, and a whole bucket is settled at once: its light
+// edges (weight <= delta) are relaxed over and over, in parallel over the
+// pool, until the bucket stops changing, then its heavy edges once.
+// Distances are lowered with an atomic compare-and-swap, so threads can
+// relax edges into the same node. delta trades work for parallelism: the
+// average edge weight is a good start. A delta so small that it would
+// take more than 2^22 buckets is raised to fit, and one that isn't a
+// positive finite number just runs Dijkstra. The pool may be nullptr.
+// Returns the distances only, the same as
+// Dijkstra(graph, source).distance.
+std::vector<double> DeltaStepping(const CsrGraph& graph, int32 source,
+                                  double delta, ThreadPool* pool);
+
+#endif
@@ -0,0 +1,83 @@
+#include "thread_pool.hpp"
+#include<vector>
+#include<thread>
+#include<mutex>
+#include<atomic>
+#include<algorithm>
+
+ThreadPool::ThreadPool(int num_threads) :
+  task_(nullptr), generation_(0), pending_(0), stop_(false) {
+  if(num_threads <= 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  // the caller is thread 0, so we only need num_threads - 1 of our own
+  for(int i = 1; i < num_threads; ++i) {
+    workers_.emplace_back(&ThreadPool::WorkerLoop, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  work_ready_.notify_all();
+  for(std::thread& worker : workers_) worker.join();
+}
+
+int ThreadPool::size() const {
+  return workers_.size() + 1;
+}
+
+void ThreadPool::WorkerLoop(int thread) {
+  int64 seen = 0;
+  while(true) {
+    const std::function<void(int)>* task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_ready_.wait(lock, [&] { return stop_ || generation_ != seen; });
+      if(stop_) return;
+      seen = generation_;
+      task = task_;
+    }
+    (*task)(thread);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      --pending_;
+    }
+    work_done_.notify_one();
+  }
+}
+
+void ThreadPool::RunOnAll(const std::function<void(int)>& task) {
+  std::lock_guard<std::mutex> run_lock(run_mutex_);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    pending_ = workers_.size();
+    ++generation_;
+  }
+  work_ready_.notify_all();
+  task(0);
+  std::unique_lock<std::mutex> lock(mutex_);
+  work_done_.wait(lock, [this] { return pending_ == 0; });
+}
+
+void ThreadPool::ParallelFor(int64 n, int64 grain,
+                             const std::function<void(int, int64, int64)>& body) {
+  if(n <= 0) return;
+  grain = std::max(grain, 1LL);
+  // not worth waking anybody up for a single chunk
+  if(n <= grain || workers_.empty()) {
+    body(0, 0, n);
+    return;
+  }
+  std::atomic<int64> next_chunk(0);
+  RunOnAll([&](int thread) {
+    while(true) {
+      int64 begin = next_chunk.fetch_add(grain);
+      if(begin >= n) return;
+      body(thread, begin, std::min(begin + grain, n));
+    }
+  });
+}
@@ -0,0 +1,70 @@
+#ifndef THREAD_POOL_H_INCLUDE
+#define THREAD_POOL_H_INCLUDE
+#include<vector>
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<functional>
+
+typedef long long int64;
+
+// A fixed set of worker threads for the parallel algorithms. Work is
+// always fork/join: a call hands the same job to every thread and returns
+// once all of them are done, so there are no futures or queues to manage.
+// The calling thread does its share of the work as thread 0.
+//
+// One job runs at a time; concurrent calls from different threads just
+// take turns. Jobs must not throw, and must not call back into the same
+// pool.
+class ThreadPool {
+ public:
+  // A pool of num_threads threads in total, the caller included. 0 means
+  // one per hardware thread.
+  explicit ThreadPool(int num_threads);
+  ~ThreadPool();
+
+  // Number of threads taking part in every job, the caller included.
+  int size() const;
+
+  // Runs task(thread) once on every thread, thread going from 0 to
+  // size() - 1, and waits for all of them.
+  void RunOnAll(const std::function<void(int)>& task);
+
+  // Splits [0, n) into chunks of grain and hands them out to the threads
+  // as they become free, calling body(thread, begin, end) for each chunk.
+  // Handing chunks out on demand is what keeps skewed work (hub nodes!)
+  // from stalling everyone on one thread.
+  void ParallelFor(int64 n, int64 grain,
+                   const std::function<void(int, int64, int64)>& body);
+
+ private:
+  void WorkerLoop(int thread);
+
+  std::vector<std::thread> workers_;
+  // only one job at a time
+  std::mutex run_mutex_;
+  // guards everything below
+  std::mutex mutex_;
+  std::condition_variable work_ready_;
+  std::condition_variable work_done_;
+  const std::function<void(int)>* task_;
+  // bumped for every job, so workers can tell a new job from a spurious
+  // wakeup
+  int64 generation_;
+  int pending_;
+  bool stop_;
+};
+
+// ThreadPool::ParallelFor for code that takes an optional pool: with a
+// pool it is the same call, with nullptr body(0, 0, n) runs once on the
+// calling thread.
+template<typename Body>
+void ParallelFor(ThreadPool* pool, int64 n, int64 grain, const Body& body) {
+  if(pool == nullptr) {
+    body(0, 0, n);
+  } else {
+    pool->ParallelFor(n, grain, body);
+  }
+}
+
+#endif
@@ -0,0 +1,198 @@
+#include "triangles.hpp"
+#include<vector>
+#include<atomic>
+#include<memory>
+#include<algorithm>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include<immintrin.h>
+#endif
+
+namespace {
+
+const int64 kGrain = 64;
+
+// The degree oriented graph: row u holds the neighbors of u that rank
+// above it, in increasing index order.
+struct Oriented {
+  std::vector<int64> offsets;
+  std::vector<int32> targets;
+  // the number of neighbors either way, self loops left out
+  std::vector<int64> degree;
+};
+
+Oriented Orient(const CsrGraph& graph, ThreadPool* pool) {
+  CsrGraph both = graph.Symmetrized();
+  int64 count = both.Count();
+  Oriented result;
+  result.degree.resize(count);
+  ParallelFor(pool, count, 4096, [&](int thread, int64 begin, int64 end) {
+    for(int32 u = begin; u < end; ++u) {
+      CsrGraph::Neighbors row = both.OutNeighbors(u);
+      bool loop = std::binary_search(row.begin(), row.end(), u);
+      result.degree[u] = row.size() - (loop ? 1 : 0);
+    }
+  });
+  const std::vector<int64>& degree = result.degree;
+  auto above = [&degree](int32 u, int32 v) {
+    return degree[v] > degree[u] || (degree[v] == degree[u] && v > u);
+  };
+  result.offsets.assign(count + 1, 0);
+  ParallelFor(pool, count, 4096, [&](int thread, int64 begin, int64 end) {
+    for(int32 u = begin; u < end; ++u) {
+      int64 kept = 0;
+      for(int32 v : both.OutNeighbors(u)) kept += above(u, v) ? 1 : 0;
+      result.offsets[u + 1] = kept;
+    }
+  });
+  for(int64 u = 0; u < count; ++u) {
+    result.offsets[u + 1] += result.offsets[u];
+  }
+  result.targets.resize(result.offsets[count]);
+  ParallelFor(pool, count, 4096, [&](int thread, int64 begin, int64 end) {
+    for(int32 u = begin; u < end; ++u) {
+      int32* out = result.targets.data() + result.offsets[u];
+      for(int32 v : both.OutNeighbors(u)) {
+        if(above(u, v)) *out++ = v;
+      }
+    }
+  });
+  return result;
+}
+
+// Calls match(x) for every x in both of the sorted, duplicate free
+// arrays a and b, in increasing order.
+template<typename Match>
+void Intersect(const int32* a, const int32* a_end,
+               const int32* b, const int32* b_end, Match&& match) {
+#if defined(__AVX2__)
+  // compare 8 of a with 8 of b by rotating b's block through all eight
+  // lanes, then move on past whichever block ends lower
+  const __m256i rotate = _mm256_set_epi32(0, 7, 6, 5, 4, 3, 2, 1);
+  while(a_end - a >= 8 && b_end - b >= 8) {
+    __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a));
+    __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b));
+    __m256i hits = _mm256_cmpeq_epi32(va, vb);
+    for(int r = 1; r < 8; ++r) {
+      vb = _mm256_permutevar8x32_epi32(vb, rotate);
+      hits = _mm256_or_si256(hits, _mm256_cmpeq_epi32(va, vb));
+    }
+    int mask = _mm256_movemask_ps(_mm256_castsi256_ps(hits));
+    while(mask != 0) {
+      match(a[__builtin_ctz(mask)]);
+      mask &= mask - 1;
+    }
+    int32 a_last = a[7];
+    int32 b_last = b[7];
+    if(a_last <= b_last) a += 8;
+    if(b_last <= a_last) b += 8;
+  }
+#elif defined(__SSE2__)
+  // the same, 4 at a time
+  while(a_end - a >= 4 && b_end - b >= 4) {
+    __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+    __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+    __m128i hits = _mm_or_si128(
+      _mm_or_si128(
+        _mm_cmpeq_epi32(va, vb),
+        _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1)))),
+      _mm_or_si128(
+        _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))),
+        _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3)))));
+    int mask = _mm_movemask_ps(_mm_castsi128_ps(hits));
+    while(mask != 0) {
+      match(a[__builtin_ctz(mask)]);
+      mask &= mask - 1;
+    }
+    int32 a_last = a[3];
+    int32 b_last = b[3];
+    if(a_last <= b_last) a += 4;
+    if(b_last <= a_last) b += 4;
+  }
+#endif
+  while(a != a_end && b != b_end) {
+    if(*a < *b) {
+      ++a;
+    } else if(*b < *a) {
+      ++b;
+    } else {
+      match(*a);
+      ++a;
+      ++b;
+    }
+  }
+}
+
+// TriangleCounts on an already oriented graph.
+std::vector<int64> CountPerNode(const Oriented& oriented, ThreadPool* pool) {
+  const int64* offsets = oriented.offsets.data();
+  const int32* targets = oriented.targets.data();
+  int64 count = oriented.degree.size();
+  // a triangle is found at its lowest node, the other two are usually
+  // some other thread's
+  std::unique_ptr<std::atomic<int64>[]> counts(new std::atomic<int64>[count]);
+  for(int64 v = 0; v < count; ++v) counts[v].store(0);
+  ParallelFor(pool, count, kGrain, [&](int thread, int64 begin, int64 end) {
+    for(int64 u = begin; u < end; ++u) {
+      const int32* u_begin = targets + offsets[u];
+      const int32* u_end = targets + offsets[u + 1];
+      int64 at_u = 0;
+      for(const int32* v = u_begin; v != u_end; ++v) {
+        int64 at_v = 0;
+        Intersect(u_begin, u_end, targets + offsets[*v],
+                  targets + offsets[*v + 1], [&](int32 w) {
+          ++at_v;
+          counts[w].fetch_add(1, std::memory_order_relaxed);
+        });
+        if(at_v != 0) counts[*v].fetch_add(at_v, std::memory_order_relaxed);
+        at_u += at_v;
+      }
+      if(at_u != 0) counts[u].fetch_add(at_u, std::memory_order_relaxed);
+    }
+  });
+  std::vector<int64> result(count);
+  for(int64 v = 0; v < count; ++v) result[v] = counts[v].load();
+  return result;
+}
+
+}  // namespace
+
+int64 CountTriangles(const CsrGraph& graph, ThreadPool* pool) {
+  Oriented oriented = Orient(graph, pool);
+  const int64* offsets = oriented.offsets.data();
+  const int32* targets = oriented.targets.data();
+  std::vector<int64> partial(pool == nullptr ? 1 : pool->size(), 0);
+  ParallelFor(pool, graph.Count(), kGrain,
+              [&](int thread, int64 begin, int64 end) {
+    int64 found = 0;
+    for(int64 u = begin; u < end; ++u) {
+      const int32* u_begin = targets + offsets[u];
+      const int32* u_end = targets + offsets[u + 1];
+      for(const int32* v = u_begin; v != u_end; ++v) {
+        Intersect(u_begin, u_end, targets + offsets[*v],
+                  targets + offsets[*v + 1], [&found](int32) { ++found; });
+      }
+    }
+    partial[thread] += found;
+  });
+  int64 total = 0;
+  for(int64 found : partial) total += found;
+  return total;
+}
+
+std::vector<int64> TriangleCounts(const CsrGraph& graph, ThreadPool* pool) {
+  return CountPerNode(Orient(graph, pool), pool);
+}
+
+std::vector<double> ClusteringCoefficients(const CsrGraph& graph,
+                                           ThreadPool* pool) {
+  Oriented oriented = Orient(graph, pool);
+  std::vector<int64> triangles = CountPerNode(oriented, pool);
+  std::vector<double> result(graph.Count(), 0.0);
+  for(int32 v = 0; v < graph.Count(); ++v) {
+    int64 degree = oriented.degree[v];
+    if(degree < 2) continue;
+    result[v] = 2.0 * triangles[v] / (static_cast<double>(degree) *
+                                       (degree - 1));
+  }
+  return result;
+}
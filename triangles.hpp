@@ -0,0 +1,38 @@
+#ifndef TRIANGLES_H_INCLUDE
+#define TRIANGLES_H_INCLUDE
+#include<vector>
+#include "csr_graph.hpp"
+#include "thread_pool.hpp"
+
+// Triangle counting on a CsrGraph, with edge directions ignored (a
+// triangle is three nodes that are pairwise connected one way or the
+// other). Self loops don't count.
+//
+// Every edge is first pointed from the endpoint of lower degree to the
+// one of higher degree (ties go by index), which makes every triangle
+// show up exactly once, at its lowest node, and keeps the lists that get
+// intersected short even for hubs: a node has at most sqrt(2m) neighbors
+// that rank above it. Then for every oriented edge u -> v the triangles
+// are the common out-neighbors of u and v. Both lists are sorted, so that
+// is a merge, done four (SSE2) or eight (AVX2, when compiled for it)
+// elements at a time, all against all, with a plain merge for the tails
+// and for other targets.
+//
+// Nodes are handed out to the pool in small chunks, so a few expensive
+// nodes don't hold up one thread. The pool may be nullptr.
+
+// The number of triangles in the graph.
+int64 CountTriangles(const CsrGraph& graph, ThreadPool* pool);
+
+// result[v] is the number of triangles node v (a dense index) is in. Sums
+// up to three times CountTriangles.
+std::vector<int64> TriangleCounts(const CsrGraph& graph, ThreadPool* pool);
+
+// Local clustering coefficients: the fraction of the pairs of v's
+// neighbors that are connected themselves, triangles / (d * (d - 1) / 2)
+// with d the number of neighbors of v either way. 0 for nodes with fewer
+// than two neighbors.
+std::vector<double> ClusteringCoefficients(const CsrGraph& graph,
+                                           ThreadPool* pool);
+
+#endif
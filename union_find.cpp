@@ -0,0 +1,69 @@
+#include "union_find.hpp"
+#include<vector>
+#include<atomic>
+#include<utility>
+
+ConcurrentUnionFind::ConcurrentUnionFind(int32 count) :
+  parent_(new std::atomic<int32>[count]) {
+  for(int32 v = 0; v < count; ++v) parent_[v].store(v);
+}
+
+int32 ConcurrentUnionFind::Find(int32 v) {
+  while(true) {
+    int32 parent = parent_[v].load(std::memory_order_relaxed);
+    if(parent == v) return v;
+    int32 grandparent = parent_[parent].load(std::memory_order_relaxed);
+    if(parent != grandparent) {
+      // skip v past its parent, if nobody moved it already
+      parent_[v].compare_exchange_weak(parent, grandparent,
+                                       std::memory_order_relaxed);
+    }
+    v = grandparent;
+  }
+}
+
+bool ConcurrentUnionFind::Union(int32 a, int32 b) {
+  while(true) {
+    a = Find(a);
+    b = Find(b);
+    if(a == b) return false;
+    if(a < b) std::swap(a, b);
+    // a is the larger root. If it is still a root, hang it under b;
+    // otherwise somebody else linked it first, find the new roots.
+    int32 expected = a;
+    if(parent_[a].compare_exchange_strong(expected, b)) return true;
+  }
+}
+
+bool ConcurrentUnionFind::SameSet(int32 a, int32 b) {
+  // roots can move while we look, so only trust a "different" answer
+  // once a is still a root after we found b's root
+  while(true) {
+    a = Find(a);
+    b = Find(b);
+    if(a == b) return true;
+    if(parent_[a].load() == a) return false;
+  }
+}
+
+Components WeaklyConnectedComponents(const CsrGraph& graph, ThreadPool* pool) {
+  int32 count = graph.Count();
+  ConcurrentUnionFind sets(count);
+  auto unite = [&](int thread, int64 begin, int64 end) {
+    for(int32 u = begin; u < end; ++u) {
+      for(int32 v : graph.OutNeighbors(u)) sets.Union(u, v);
+    }
+  };
+  ParallelFor(pool, count, 1024, unite);
+  // roots are the smallest index of their set, so going up in index
+  // order meets every root before the rest of its set
+  Components result;
+  result.component.resize(count);
+  result.count = 0;
+  for(int32 v = 0; v < count; ++v) {
+    int32 root = sets.Find(v);
+    result.component[v] = root == v ? result.count++ :
+      result.component[root];
+  }
+  return result;
+}
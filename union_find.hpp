@@ -0,0 +1,41 @@
+#ifndef UNION_FIND_H_INCLUDE
+#define UNION_FIND_H_INCLUDE
+#include<atomic>
+#include<memory>
+#include "csr_graph.hpp"
+#include "scc.hpp"
+#include "thread_pool.hpp"
+
+// Disjoint sets over dense indices 0..count-1 that any number of threads
+// can merge and query at once, without locks (Anderson and Woll style).
+//
+// Every set is a tree of parent pointers, and a root always points to a
+// smaller index than anything below it: Union hangs the root with the
+// larger index under the other one with a compare-and-swap, and simply
+// tries again if another thread changed that root in the meantime. Find
+// halves the path as it walks it, also with compare-and-swap; a failed
+// one only means another thread shortened the path first.
+class ConcurrentUnionFind {
+ public:
+  explicit ConcurrentUnionFind(int32 count);
+
+  // The root of v's set.
+  int32 Find(int32 v);
+
+  // Merges the sets of a and b. Returns false if they were one set
+  // already.
+  bool Union(int32 a, int32 b);
+
+  bool SameSet(int32 a, int32 b);
+
+ private:
+  std::unique_ptr<std::atomic<int32>[]> parent_;
+};
+
+// Weakly connected components: the components of the graph with edge
+// directions ignored. Every edge is a Union, spread over the pool (which
+// may be nullptr). Components are numbered in the order of their lowest
+// dense index.
+Components WeaklyConnectedComponents(const CsrGraph& graph, ThreadPool* pool);
+
+#endif